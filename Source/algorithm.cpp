@@ -1,8 +1,11 @@
 #include "algorithm.h"
+#include "parallel.h"
+#include "serialization.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstdlib>
-#include <ctime>
 #include <iostream>
 #include <limits>
 
@@ -13,29 +16,215 @@
 namespace rise
 {
 
-RiseClassifier::RiseClassifier(bool verbose) : verbose_(verbose) {}
+namespace /* utils for internal usage */
+{
+
+double elapsed_since(const std::chrono::steady_clock::time_point& start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// number of instances whose distances to a rule are computed together by predict
+const int PREDICT_BLOCK = 64;
+
+/*
+ * Conditions of the rules of a classifier (in the order of the linear scan)
+ * packed by attribute, and lookup tables with an extra column for missing
+ * values (coded as the domain size), so the distances to a block of
+ * instances are computed without branches or special cases.
+ */
+struct PackedRules
+{
+  int n_rules;
+  std::vector<double> bounds;               // [rule][real slot][lo,up]
+  std::vector<uint32_t> categories;         // [rule][nominal slot]
+  std::vector<int> n_dropped;               // [rule]
+  std::vector<double> f1_scores;            // [rule]
+  std::vector<uint32_t> consequents;        // [rule]
+  std::vector<std::vector<double>> lookups; // [nominal slot][category][code or missing]
+
+  PackedRules(const Schema& schema, const std::vector<Rule::Ptr>& rules)
+    : n_rules(rules.size()), n_dropped(n_rules, 0), f1_scores(n_rules), consequents(n_rules)
+  {
+    for (int r = 0; r < n_rules; ++r)
+    {
+      const Rule& rule = *rules[r];
+      bounds.insert(bounds.end(), rule.get_bounds().begin(), rule.get_bounds().end());
+      categories.insert(categories.end(), rule.get_categories().begin(),
+                        rule.get_categories().end());
+      for (int k = 0; k < schema.real_columns.size(); ++k)
+      {
+        if (std::isnan(rule.get_bounds()[2*k])) ++n_dropped[r];
+      }
+      for (uint32_t category : rule.get_categories())
+      {
+        if (category == Rule::DROPPED) ++n_dropped[r];
+      }
+      f1_scores[r] = rule.get_f1_score();
+      consequents[r] = rule.get_consequent_code();
+    }
+    for (const NominalAttributeMeta* meta : schema.nominal_meta)
+    {
+      uint32_t domain_size = meta->get_domain_size();
+      lookups.push_back(std::vector<double>(domain_size*(domain_size+1), 0.0));
+      for (uint32_t c1 = 0; c1 < domain_size; ++c1)
+      {
+        for (uint32_t c2 = 0; c2 < domain_size; ++c2)
+        {
+          lookups.back()[c1*(domain_size+1) + c2] = meta->lookup_distance(c1, c2);
+        }
+      }
+    }
+  }
+};
+
+/*
+ * Same computations (and in the same order, so the results are identical) as
+ * Rule::distance and the linear scan of RuleIndex::nearest, for the instances
+ * [begin, end) of df (at most PREDICT_BLOCK).
+ */
+void predict_block(const Schema& schema, const PackedRules& packed, const Dataframe& df,
+    int begin, int end, uint32_t* codes)
+{
+  const int n_real = schema.real_columns.size();
+  const int n_nominal = schema.nominal_columns.size();
+  const int n = end - begin;
+  /* the block, transposed and padded (with missing values) up to PREDICT_BLOCK */
+  std::vector<double> reals(n_real*PREDICT_BLOCK, std::numeric_limits<double>::quiet_NaN());
+  std::vector<uint32_t> nominals(n_nominal*PREDICT_BLOCK);
+  for (int k = 0; k < n_real; ++k)
+  {
+    const std::vector<double>& column = df.get_real_column(schema.real_columns[k]);
+    std::copy(column.begin() + begin, column.begin() + end, &reals[k*PREDICT_BLOCK]);
+  }
+  for (int k = 0; k < n_nominal; ++k)
+  {
+    const std::vector<uint32_t>& column = df.get_nominal_column(schema.nominal_columns[k]);
+    uint32_t missing = schema.nominal_meta[k]->get_domain_size();
+    uint32_t* block = &nominals[k*PREDICT_BLOCK];
+    for (int b = 0; b < PREDICT_BLOCK; ++b)
+    {
+      block[b] = b < n and column[begin+b] != NominalAttributeMeta::MISSING?
+                 column[begin+b] : missing;
+    }
+  }
+  // counts are kept as doubles (exact for small integers) so the loops vectorize
+  double dist[PREDICT_BLOCK], count[PREDICT_BLOCK];
+  double min_dist[PREDICT_BLOCK], winner_f1[PREDICT_BLOCK];
+  int winner[PREDICT_BLOCK];
+  for (int r = 0; r < packed.n_rules; ++r)
+  {
+    for (int b = 0; b < PREDICT_BLOCK; ++b)
+    {
+      dist[b] = 0.0;
+      count[b] = packed.n_dropped[r];
+    }
+    const double* bounds = &packed.bounds[2*r*n_real];
+    for (int k = 0; k < n_real; ++k)
+    {
+      const double lo = bounds[2*k], up = bounds[2*k+1];
+      if (std::isnan(lo)) continue;
+      const double range = schema.real_meta[k]->get_range();
+      const double* x = &reals[k*PREDICT_BLOCK];
+      if (range > 0)
+      {
+        for (int b = 0; b < PREDICT_BLOCK; ++b)
+        {
+          // at most one of the differences is positive, none if x is missing
+          // (std::max(0.0, NaN) is 0), and adding 0 leaves the distance as it was
+          dist[b] += (std::max(0.0, lo - x[b]) + std::max(0.0, x[b] - up))/range;
+          count[b] += x[b] == x[b]? 1.0 : 0.0;
+        }
+      }
+      else
+      {
+        // (constant attribute in training) only values out of it are infinitely far
+        for (int b = 0; b < PREDICT_BLOCK; ++b)
+        {
+          if (x[b] < lo or x[b] > up) dist[b] += std::numeric_limits<double>::infinity();
+          count[b] += x[b] == x[b]? 1.0 : 0.0;
+        }
+      }
+    }
+    const uint32_t* categories = &packed.categories[r*n_nominal];
+    for (int k = 0; k < n_nominal; ++k)
+    {
+      if (categories[k] == Rule::DROPPED) continue;
+      const uint32_t missing = schema.nominal_meta[k]->get_domain_size();
+      const double* row = &packed.lookups[k][categories[k]*(missing+1)];
+      const uint32_t* code = &nominals[k*PREDICT_BLOCK];
+      for (int b = 0; b < PREDICT_BLOCK; ++b)
+      {
+        dist[b] += row[code[b]];
+        count[b] += code[b] != missing? 1.0 : 0.0;
+      }
+    }
+    const double f1 = packed.f1_scores[r];
+    for (int b = 0; b < n; ++b)
+    {
+      double d = dist[b]/count[b];
+      // the first rule is the initial winner, and a NaN distance cannot be beaten
+      if (r == 0 or d < min_dist[b]-1e-9 or
+          (std::fabs(d - min_dist[b]) <= 1e-9 and f1 > winner_f1[b]))
+      {
+        min_dist[b] = d;
+        winner_f1[b] = f1;
+        winner[b] = r;
+      }
+    }
+  }
+  for (int b = 0; b < n; ++b) codes[b] = packed.consequents[winner[b]];
+}
+
+const char MODEL_MAGIC[8] = {'R', 'I', 'S', 'E', 'M', 'D', 'L', '\0'};
+const uint32_t MODEL_VERSION = 1;
+
+} /* end anonymous namespace */
+
+RiseClassifier::RiseClassifier(bool verbose, int num_threads)
+  : verbose_(verbose), num_threads_(num_threads), train_time_(0) {}
 
 void RiseClassifier::train(const Dataframe& df)
 {
   rs_.clear();
+  index_.clear();
+  schema_ = df.get_schema();
 
   rs_.reserve(df.get_number_of_records());
 
   DistanceCache dcache;
 
-  std::clock_t start = clock();
+  // wall time (CPU time would add up the time spent by every thread)
+  auto start = std::chrono::steady_clock::now();
 
   for (const Instance& instance : df.get_instances())
   {
-    Rule::Ptr rule = std::make_shared<Rule>(instance, df.get_xmeta());
+    Rule::Ptr rule = std::make_shared<Rule>(instance);
     rule->evaluate_rule(df);
     rs_.insert(rule);
   }
 
+  index_.build(rs_);
   double acc = accuracy(df, dcache, true);
 
+  // the instances do not change while training, unlike the rules
+  InstanceIndex instance_index;
+  instance_index.build(df);
+
   INFO("Initial accuracy (Leave One Out): " << acc*100 << "%");
 
+  /* candidates are computed and scored in parallel in batches (against the
+   * distance cache at the beginning of the batch) and committed serially in
+   * the order of freeze, updating their scores with the changes made by the
+   * previous commits of the batch. So the result does not depend on the
+   * number of threads */
+  int num_threads = resolve_num_threads(num_threads_);
+  int batch_size = 16*num_threads;
+  std::vector<Candidate> candidates(batch_size);
+  std::vector<double> bounds(df.get_number_of_records());
+  DistanceCacheJournal journal;
+  journal.recorded.assign(df.get_number_of_records(), false);
+
   bool increase_acc = true;
   bool new_rules = false;
 
@@ -44,17 +233,29 @@ void RiseClassifier::train(const Dataframe& df)
     increase_acc = false;
     new_rules = false;
     std::vector<Rule::Ptr> freeze(rs_.begin(), rs_.end());
-    for (const Rule::Ptr& rule : freeze)
+    for (int batch_start = 0; batch_start < freeze.size(); batch_start += batch_size)
     {
-      const Instance* nearest = find_nearest_instance(df, rule);
-      if (nearest)
+      int batch_end = std::min<int>(batch_start + batch_size, freeze.size());
+      /* the distances of the candidates are only needed when they may beat the
+       * nearest rule of the instance, so they are bounded by the distances of
+       * the cache at the beginning of the batch */
+      for (int idx = 0; idx < bounds.size(); ++idx) bounds[idx] = dcache[idx].second + 1e-9;
+      parallel_for(batch_end - batch_start, num_threads, [&](int idx)
+      {
+        Candidate& candidate = candidates[idx];
+        generalize(df, instance_index, freeze[batch_start+idx], bounds, candidate);
+        if (candidate.found) delta_accuracy(df, bounds, dcache, candidate);
+      });
+      for (int idx = batch_start; idx < batch_end; ++idx)
       {
-        auto new_rule = rule->adapt(*nearest);
-        new_rule->evaluate_rule(df);
-        DistanceCache bk = dcache;
-        double delta_acc = delta_accuracy(df, new_rule, dcache);
+        const Rule::Ptr& rule = freeze[idx];
+        Candidate& candidate = candidates[idx-batch_start];
+        if (not candidate.found) continue;
+        const Rule::Ptr& new_rule = candidate.new_rule;
+        double delta_acc = update_delta_accuracy(df, bounds, dcache, journal, candidate);
         if (delta_acc >= 0)
         {
+          commit(candidate, dcache, journal);
           if (delta_acc > 0)
           {
             acc += delta_acc;
@@ -69,32 +270,122 @@ void RiseClassifier::train(const Dataframe& df)
           }
           rs_.erase(rule);
         }
-        else dcache = bk;
       }
+      for (const auto& entry : journal.entries) journal.recorded[entry.first] = false;
+      journal.entries.clear();
     }
     INFO("Current size of RuleSet: " << rs_.size() <<
          " (increase_acc: " << (increase_acc? "true" : "false") <<
          ", new_rules: " << (new_rules? "true" : "false") <<
-         ", elapsed: " << ((double)(clock()-start))/CLOCKS_PER_SEC << "s)");
+         ", elapsed: " << elapsed_since(start) << "s)");
   }
-  train_time_ = ((double)(clock()-start))/CLOCKS_PER_SEC;
+  train_time_ = elapsed_since(start);
   INFO("Total elapsed: " << train_time_ << 's');
+  index_.build(rs_);
   acc = accuracy(df, dcache, false);
   INFO("Final LOO (Leave One Out) accuracy (only in training!!): " << acc*100 << '%');
 }
 
 double RiseClassifier::test(const Dataframe& df) const
 {
+  std::vector<uint32_t> codes = predict(df);
   double acc = 0;
-  for (const Instance& instance : df.get_instances())
+  for (int row = 0; row < codes.size(); ++row)
   {
-    std::string category = classify(instance);
-    if (category == instance.get_class()) acc += 1;
+    if (codes[row] == df.get_class_code(row)) acc += 1;
   }
   acc /= df.get_number_of_records();
   return acc;
 }
 
+/*
+ * Models are binary files (see BinaryWriter) with the metadata of the
+ * attributes and the number of rules (uint64_t) followed by the rules: their
+ * bounds (array of double), categories (array of uint32_t), consequent
+ * (uint32_t) and the counts their scores are computed from (3 int32_t).
+ */
+void RiseClassifier::save(const std::string& filename) const
+{
+  if (not schema_) throw RiseException("Cannot save a classifier that has not been trained");
+  BinaryWriter writer(filename, MODEL_MAGIC, MODEL_VERSION);
+  write_attributes(writer, schema_->xmeta, schema_->ymeta);
+  const std::vector<Rule::Ptr>& rules = index_.get_rules();
+  writer.write<uint64_t>(rules.size());
+  for (const Rule::Ptr& rule : rules)
+  {
+    writer.write_array(rule->get_bounds());
+    writer.write_array(rule->get_categories());
+    writer.write(rule->get_consequent_code());
+    writer.write<int32_t>(rule->get_n_instances_covered());
+    writer.write<int32_t>(rule->get_n_correctly_classified());
+    writer.write<int32_t>(rule->get_n_instances_same_class());
+  }
+  writer.close();
+}
+
+void RiseClassifier::load(const std::string& filename)
+{
+  BinaryReader reader(filename, MODEL_MAGIC, MODEL_VERSION);
+  std::vector<AttributeMeta::Ptr> xmeta;
+  AttributeMeta::Ptr ymeta;
+  read_attributes(reader, xmeta, ymeta);
+  Schema::Ptr schema = std::make_shared<Schema>(xmeta, ymeta);
+  for (const NominalAttributeMeta* meta : schema->nominal_meta)
+  {
+    if (meta->get_lookup().empty()) reader.fail("Missing lookup table of " + meta->get_name());
+  }
+  uint64_t n_rules = reader.read<uint64_t>();
+  if (n_rules == 0) reader.fail("The model has no rules");
+  std::vector<Rule::Ptr> rules;
+  for (uint64_t idx = 0; idx < n_rules; ++idx)
+  {
+    std::vector<double> bounds;
+    std::vector<uint32_t> categories;
+    reader.read_array(bounds);
+    reader.read_array(categories);
+    uint32_t consequent = reader.read<uint32_t>();
+    int32_t n_instances_covered = reader.read<int32_t>();
+    int32_t n_correctly_classified = reader.read<int32_t>();
+    int32_t n_instances_same_class = reader.read<int32_t>();
+    /* codes are checked, so a corrupt file cannot yield out of range accesses */
+    bool consistent = bounds.size() == 2*schema->real_columns.size() and
+                      categories.size() == schema->nominal_columns.size() and
+                      consequent < schema->ymeta->get_domain_size();
+    for (int k = 0; k < categories.size() and consistent; ++k)
+    {
+      consistent = categories[k] == Rule::DROPPED or
+                   categories[k] < schema->nominal_meta[k]->get_domain_size();
+    }
+    if (not consistent) reader.fail("Inconsistent rule in the model");
+    rules.push_back(std::make_shared<Rule>(schema, bounds, categories, consequent,
+        n_instances_covered, n_correctly_classified, n_instances_same_class));
+  }
+  if (not reader.at_end()) reader.fail("Unexpected data at the end of the model");
+  schema_ = schema;
+  rs_.clear();
+  rs_.insert(rules.begin(), rules.end());
+  index_.build(rules);
+  train_time_ = 0;
+}
+
+std::vector<uint32_t> RiseClassifier::predict(const Dataframe& df) const
+{
+  const std::vector<Rule::Ptr>& rules = index_.get_rules();
+  if (rules.empty()) throw RiseException("Cannot predict with a classifier without rules");
+  const Schema& schema = *schema_;
+  PackedRules packed(schema, rules);
+  int n_records = df.get_number_of_records();
+  std::vector<uint32_t> codes(n_records);
+  int n_blocks = (n_records + PREDICT_BLOCK - 1)/PREDICT_BLOCK;
+  parallel_for(n_blocks, num_threads_, [&](int block)
+  {
+    int begin = block*PREDICT_BLOCK;
+    int end = std::min(begin + PREDICT_BLOCK, n_records);
+    predict_block(schema, packed, df, begin, end, &codes[begin]);
+  });
+  return codes;
+}
+
 std::string RiseClassifier::to_str() const
 {
   std::ostringstream oss;
@@ -108,31 +399,7 @@ std::string RiseClassifier::to_str() const
 
 Rule::Ptr RiseClassifier::classify(const Instance& instance, double &min_dist, bool loo) const
 {
-  std::vector<Rule::Ptr> candidates;
-  min_dist = std::numeric_limits<double>::infinity();
-  Rule::Ptr winner;
-  for (const Rule::Ptr& rule : rs_)
-  {
-    double dist = rule->distance(instance);
-    if (not winner)
-    {
-      winner = rule;
-      min_dist = dist;
-      continue;
-    }
-    if (loo and dist < 1e-9 and rule->get_n_instances_covered() < 2) continue;
-    if (dist < min_dist-1e-9)
-    {
-      min_dist = dist;
-      winner = rule;
-    }
-    else if (std::fabs(dist - min_dist) <= 1e-9 and
-             rule->get_f1_score() > winner->get_f1_score())
-    {
-      winner = rule;
-    }
-  }
-  return winner;
+  return index_.nearest(instance, min_dist, loo);
 }
 
 std::string RiseClassifier::classify(const Instance& instance, bool loo) const
@@ -149,52 +416,125 @@ double RiseClassifier::accuracy(const Dataframe& df, DistanceCache& dcache, bool
   {
     const Instance& instance = df.get_instances()[idx];
     dcache[idx].first = classify(instance, dcache[idx].second, loo);
-    if (dcache[idx].first->get_consequent() == instance.get_class())
+    if (dcache[idx].first->get_consequent_code() == instance.get_class_code())
       ++n_correctly_classified;
   }
   return ((double)n_correctly_classified)/df.get_number_of_records();
 }
 
-double RiseClassifier::delta_accuracy(const Dataframe& df,
-    const Rule::Ptr& new_rule, DistanceCache& dcache) const
+double RiseClassifier::delta_accuracy(const Dataframe& df, const std::vector<double>& bounds,
+    const DistanceCache& dcache, Candidate& candidate) const
 {
-  int rescued = 0;
+  const Rule& new_rule = *candidate.new_rule;
+  candidate.wins.clear();
+  candidate.rescued = 0;
   for (int idx = 0; idx < df.get_number_of_records(); ++idx)
   {
+    double dist = candidate.distances[idx];
+    // a distance over its bound can only win if the cache has grown since
+    // (a tie with a better f1 score may replace a rule by a farther one)
+    double bound = dcache[idx].second + 1e-9;
+    if (dist > bounds[idx] and bound > bounds[idx])
+    {
+      dist = new_rule.distance(df.get_instances()[idx], bound);
+    }
+    if (wins_instance(new_rule, dist, dcache[idx]))
+    {
+      candidate.wins.push_back(std::make_pair(idx, dist));
+      candidate.rescued += delta_correct(new_rule, dcache[idx], df.get_instances()[idx]);
+    }
+  }
+  return ((double)candidate.rescued)/df.get_number_of_records();
+}
+
+double RiseClassifier::update_delta_accuracy(const Dataframe& df,
+    const std::vector<double>& bounds, const DistanceCache& dcache,
+    const DistanceCacheJournal& journal, Candidate& candidate) const
+{
+  /* the score of the candidate was computed when the entries in the journal
+   * had their earlier values (and the distances were bounded by them), so
+   * only those instances are scored again */
+  if (journal.entries.empty()) return ((double)candidate.rescued)/df.get_number_of_records();
+  const Rule& new_rule = *candidate.new_rule;
+  int n_wins = 0;
+  for (const auto& win : candidate.wins)
+  {
+    if (not journal.recorded[win.first]) candidate.wins[n_wins++] = win;
+  }
+  candidate.wins.resize(n_wins);
+  for (const auto& entry : journal.entries)
+  {
+    int idx = entry.first;
     const Instance& instance = df.get_instances()[idx];
-    double dist = new_rule->distance(instance);
-    bool wins_instance = dist < dcache[idx].second-1e-9 or
-      (std::fabs(dist - dcache[idx].second) <= 1e-9 and
-       new_rule->get_f1_score() > dcache[idx].first->get_f1_score());
-    if (wins_instance)
+    double dist = candidate.distances[idx];
+    if (wins_instance(new_rule, dist, entry.second))
     {
-      bool new_is_correct = new_rule->get_consequent() == instance.get_class();
-      bool old_is_correct = dcache[idx].first->get_consequent() == instance.get_class();
-      if (new_is_correct and not old_is_correct) ++rescued;
-      else if (not new_is_correct and old_is_correct) --rescued;
-      dcache[idx].first = new_rule;
-      dcache[idx].second = dist;
+      candidate.rescued -= delta_correct(new_rule, entry.second, instance);
+    }
+    double bound = dcache[idx].second + 1e-9;
+    if (dist > bounds[idx] and bound > bounds[idx]) dist = new_rule.distance(instance, bound);
+    if (wins_instance(new_rule, dist, dcache[idx]))
+    {
+      candidate.wins.push_back(std::make_pair(idx, dist));
+      candidate.rescued += delta_correct(new_rule, dcache[idx], instance);
     }
   }
-  return ((double)rescued)/df.get_number_of_records();
+  return ((double)candidate.rescued)/df.get_number_of_records();
 }
 
-const Instance* RiseClassifier::find_nearest_instance(const Dataframe& df,
-    const Rule::Ptr& rule)
+void RiseClassifier::commit(const Candidate& candidate, DistanceCache& dcache,
+    DistanceCacheJournal& journal)
 {
-  double min_distance = std::numeric_limits<double>::infinity();
-  const Instance* nearest = nullptr;
-  for (const Instance& instance : df.get_instances())
+  for (const auto& win : candidate.wins)
   {
-    double distance = rule->distance(instance);
-    if (instance.get_class() == rule->get_consequent() and
-        distance > 1e-9)
+    int idx = win.first;
+    if (not journal.recorded[idx])
     {
-      nearest = &instance;
-      if (distance < min_distance) min_distance = distance;
+      journal.recorded[idx] = true;
+      journal.entries.push_back(std::make_pair(idx, std::move(dcache[idx])));
     }
+    dcache[idx].first = candidate.new_rule;
+    dcache[idx].second = win.second;
+  }
+}
+
+bool RiseClassifier::wins_instance(const Rule& new_rule, double dist,
+    const RuleAndDistance& nearest)
+{
+  return dist < nearest.second-1e-9 or
+    (std::fabs(dist - nearest.second) <= 1e-9 and
+     new_rule.get_f1_score() > nearest.first->get_f1_score());
+}
+
+int RiseClassifier::delta_correct(const Rule& new_rule, const RuleAndDistance& nearest,
+    const Instance& instance)
+{
+  bool new_is_correct = new_rule.get_consequent_code() == instance.get_class_code();
+  bool old_is_correct = nearest.first->get_consequent_code() == instance.get_class_code();
+  return new_is_correct - old_is_correct;
+}
+
+void RiseClassifier::generalize(const Dataframe& df, const InstanceIndex& instance_index,
+    const Rule::Ptr& rule, const std::vector<double>& bounds, Candidate& candidate)
+{
+  /* the rule is generalized towards the nearest instance of its class that
+   * it does not cover yet */
+  double min_dist;
+  const Instance* nearest = instance_index.nearest(*rule, min_dist);
+  candidate.found = nearest != nullptr;
+  if (not nearest) return;
+  // a committed rule is shared with the rule set or the distance cache
+  if (candidate.new_rule and candidate.new_rule.use_count() == 1)
+  {
+    rule->adapt(*nearest, *candidate.new_rule);
+  }
+  else candidate.new_rule = rule->adapt(*nearest);
+  candidate.new_rule->evaluate_rule(df);
+  candidate.distances.resize(df.get_number_of_records());
+  for (int idx = 0; idx < df.get_number_of_records(); ++idx)
+  {
+    candidate.distances[idx] = candidate.new_rule->distance(df.get_instances()[idx], bounds[idx]);
   }
-  return nearest;
 }
 
 }
@@ -2,6 +2,8 @@
 #define ALGORITHM_H
 
 #include "dataframe.h"
+#include "instance_index.h"
+#include "rule_index.h"
 #include "rules.h"
 
 namespace rise
@@ -11,7 +13,7 @@ class RiseClassifier : public Stringifiable
 {
   public:
 
-    RiseClassifier(bool verbose=false);
+    RiseClassifier(bool verbose=false, int num_threads=1);
 
     void train(const Dataframe& df);
 
@@ -19,6 +21,39 @@ class RiseClassifier : public Stringifiable
 
     double get_train_time() const { return train_time_; }
 
+    int get_number_of_rules() const { return index_.size(); }
+
+    int get_num_threads() const { return num_threads_; }
+
+    void set_num_threads(int num_threads) { num_threads_ = num_threads; }
+
+    // metadata of the attributes of the training data (or of the loaded model)
+    const Schema::Ptr& get_schema() const { return schema_; }
+
+    /*
+     * The instance must be encoded with the schema of the classifier (see the
+     * Dataframe constructor that takes a schema).
+     */
+    std::string classify(const Instance& instance, bool loo=false) const;
+
+    /*
+     * Class codes of all the instances of df (encoded with the schema of the
+     * classifier), the same that classify would give. Instances are processed
+     * in blocks, computing the distances of every rule to a whole block with
+     * loops over contiguous values that the compiler can vectorize, and blocks
+     * are spread among num_threads threads.
+     */
+    std::vector<uint32_t> predict(const Dataframe& df) const;
+
+    /*
+     * Binary file with the metadata of the attributes (including the lookup
+     * tables) and the rules in the order in which they are searched, so the
+     * loaded classifier gives the same results without the training data.
+     */
+    void save(const std::string& filename) const;
+
+    void load(const std::string& filename);
+
     virtual std::string to_str() const override;
 
   private:
@@ -26,22 +61,68 @@ class RiseClassifier : public Stringifiable
     typedef std::pair<Rule::Ptr, double> RuleAndDistance;
     typedef std::vector<RuleAndDistance> DistanceCache;
 
+    /*
+     * Earlier values of the entries of a DistanceCache modified since the
+     * journal was cleared (only the first modification of each entry is kept).
+     */
+    struct DistanceCacheJournal
+    {
+      std::vector<std::pair<int, RuleAndDistance>> entries;
+      std::vector<bool> recorded;
+    };
+
+    /*
+     * Generalization of a rule towards its nearest instance. It only depends
+     * on the rule and the training data, so candidates can be computed in
+     * parallel and then committed one by one. Rejected candidates are recycled:
+     * their rule is overwritten by the next generalization computed in the
+     * same slot, so only committed rules are allocated.
+     */
+    struct Candidate
+    {
+      bool found; // false if there was no instance to generalize the rule to
+      Rule::Ptr new_rule;
+      // from new_rule to every instance, or infinity when it was greater than
+      // the bound given to generalize for the instance
+      std::vector<double> distances;
+      // instances won by new_rule (and their distances), and the number of
+      // them that become correctly classified minus the number of them that
+      // become misclassified
+      std::vector<std::pair<int, double>> wins;
+      int rescued;
+    };
+
     bool verbose_;
+    int num_threads_;
+    Schema::Ptr schema_;
     RuleSet rs_;
+    RuleIndex index_; // over rs_, used by classify (rebuilt whenever rs_ changes)
     double train_time_;
 
     double acc(const Dataframe& df) const;
 
     Rule::Ptr classify(const Instance& instance, double &min_dist, bool loo=false) const;
 
-    std::string classify(const Instance& instance, bool loo=false) const;
-
     double accuracy(const Dataframe& df, DistanceCache& dcache, bool loo=false) const;
 
-    double delta_accuracy(const Dataframe& df, const Rule::Ptr& new_rule,
-        DistanceCache& dcache) const;
+    double delta_accuracy(const Dataframe& df, const std::vector<double>& bounds,
+        const DistanceCache& dcache, Candidate& candidate) const;
+
+    double update_delta_accuracy(const Dataframe& df, const std::vector<double>& bounds,
+        const DistanceCache& dcache, const DistanceCacheJournal& journal,
+        Candidate& candidate) const;
+
+    static void commit(const Candidate& candidate, DistanceCache& dcache,
+        DistanceCacheJournal& journal);
+
+    static bool wins_instance(const Rule& new_rule, double dist,
+        const RuleAndDistance& nearest);
+
+    static int delta_correct(const Rule& new_rule, const RuleAndDistance& nearest,
+        const Instance& instance);
 
-    static const Instance* find_nearest_instance(const Dataframe& df, const Rule::Ptr& rule);
+    static void generalize(const Dataframe& df, const InstanceIndex& instance_index,
+        const Rule::Ptr& rule, const std::vector<double>& bounds, Candidate& candidate);
 
 };
 
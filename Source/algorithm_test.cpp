@@ -1,4 +1,5 @@
 #include "algorithm.h"
+#include <cstdio>
 #include <iostream>
 
 int main(int argc, char* argv[])
@@ -19,6 +20,31 @@ int main(int argc, char* argv[])
     std::cout << df << std::endl;
     rise::RiseClassifier classifier(true);
     classifier.train(df);
+    /* batch predictions must be the same as the ones of classify */
+    std::vector<uint32_t> codes = classifier.predict(df);
+    int differences = 0;
+    for (int row = 0; row < df.get_number_of_records(); ++row)
+    {
+      const std::string& category = classifier.get_schema()->ymeta->get_category(codes[row]);
+      if (classifier.classify(df.get_instances()[row]) != category) ++differences;
+    }
+    std::cout << "#Differences between predict and classify: " << differences << std::endl;
+    /* a loaded model must classify data encoded with its schema as the trained one */
+    std::string model = std::string("/tmp/") + argv[1] + ".model";
+    classifier.save(model);
+    rise::RiseClassifier loaded;
+    loaded.load(model);
+    std::remove(model.c_str());
+    rise::Dataframe encoded(datafile, metafile, loaded.get_schema());
+    differences = 0;
+    for (const rise::Instance& instance : df.get_instances())
+    {
+      const rise::Instance& same = encoded.get_instances()[instance.get_index()];
+      if (classifier.classify(instance) != loaded.classify(same)) ++differences;
+    }
+    std::cout << "#Different predictions of the loaded model: " << differences << std::endl;
+    std::cout << "Accuracy of the loaded model (only in training!!): "
+              << loaded.test(encoded)*100 << '%' << std::endl;
   }
   catch (rise::RiseException& ex)
   {
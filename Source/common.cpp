@@ -1,109 +1,99 @@
+
 #include "common.h"
 #include <algorithm>
 #include <limits>
-#include <typeinfo>
 
 namespace rise
 {
 
 // RealAttributeMeta's methods
 
-RealAttribute::Ptr RealAttribute::create(const std::string& value)
-{
-  if (value == "?") return Ptr(); // missing value
-  return std::make_shared<RealAttribute>(std::stod(value));
-}
-
-RealAttribute::Ptr RealAttribute::create(double number)
-{
-  return std::make_shared<RealAttribute>(number);
-}
-
-bool RealAttribute::operator==(const Attribute& other) const
+std::string RealAttributeMeta::to_str() const
 {
-  try
-  {
-    auto rattr = dynamic_cast<const RealAttribute&>(other);
-    return std::fabs(number_ - rattr.number_) < 1e-5;
-  }
-  catch (std::bad_cast&)
-  {
-    return false;
-  }
+  std::ostringstream oss;
+  oss << get_name() << " (real attribute in range [" << lower_bound_
+      << ',' << upper_bound_ << "])";
+  return oss.str();
 }
 
-// NominalAttribute's methods
+// NominalAttributeMeta's methods
 
-NominalAttribute::Ptr NominalAttribute::create(const std::string& value)
-{
-  if (value == "?") return Ptr();
-  return std::make_shared<NominalAttribute>(value);
-}
+constexpr uint32_t NominalAttributeMeta::MISSING;
 
-bool NominalAttribute::operator==(const Attribute& other) const
+void NominalAttributeMeta::set_domain(const std::set<std::string>& domain)
 {
-  try
-  {
-    auto nattr = dynamic_cast<const NominalAttribute&>(other);
-    return category_ == nattr.category_;
-  }
-  catch (std::bad_cast&)
-  {
-    return false;
-  }
+  domain_.assign(domain.begin(), domain.end());
+  distance_lu_.clear();
 }
 
-std::string RealAttributeMeta::to_str() const
+uint32_t NominalAttributeMeta::get_code(const std::string& category) const
 {
-  std::ostringstream oss;
-  oss << get_name() << " (real attribute in range [" << lower_bound_
-      << ',' << upper_bound_ << "])";
-  return oss.str();
+  auto it = std::lower_bound(domain_.begin(), domain_.end(), category);
+  if (it == domain_.end() or *it != category) return MISSING;
+  return it - domain_.begin();
 }
 
-// NominalAttributeMeta's methods
-
 std::string NominalAttributeMeta::to_str() const
 {
   std::ostringstream oss;
   oss << get_name() << " (nominal attribute with domain "
       << container2str(domain_) << ')';
-  //for (const auto& entry : distance_lu_)
+  //for (uint32_t c1 = 0; c1 < domain_.size(); ++c1)
   //{
-    //oss << "\n  D(" << entry.first.first << ',' << entry.first.second << ") = " << entry.second;
+    //for (uint32_t c2 = 0; c2 < domain_.size(); ++c2)
+    //{
+      //oss << "\n  D(" << domain_[c1] << ',' << domain_[c2] << ") = " << lookup_distance(c1, c2);
+    //}
   //}
   return oss.str();
 }
 
-double NominalAttributeMeta::lookup_distance(const std::string& c1,
-    const std::string& c2) const
+void NominalAttributeMeta::set_lookup(const std::vector<double>& lu)
 {
-  double distance = std::numeric_limits<double>::infinity();
-  auto it = distance_lu_.find(std::make_pair(c1, c2));
-  if (it != distance_lu_.end()) distance = it->second;
-  return distance;
+  if (lu.size() != domain_.size()*domain_.size())
+  {
+    throw RiseException(std::string("Lookup table size does not match domain of ") + get_name());
+  }
+  distance_lu_ = lu;
 }
 
-// Instance's methods
-
-const std::string& Instance::get_class() const
+double NominalAttributeMeta::lookup_distance(const std::string& c1,
+    const std::string& c2) const
 {
-  return std::dynamic_pointer_cast<NominalAttribute>(y_)->get_category();
+  uint32_t code1 = get_code(c1);
+  uint32_t code2 = get_code(c2);
+  if (code1 == MISSING or code2 == MISSING or distance_lu_.empty())
+  {
+    return std::numeric_limits<double>::infinity();
+  }
+  return lookup_distance(code1, code2);
 }
 
-std::string Instance::to_str() const
+// Schema's methods
+
+Schema::Schema(const std::vector<AttributeMeta::Ptr>& xmeta, const AttributeMeta::Ptr& ymeta)
+  : xmeta(xmeta), ymeta(std::dynamic_pointer_cast<NominalAttributeMeta>(ymeta))
 {
-  std::ostringstream oss;
-  oss << index_ << ": x=[";
-  bool first = true;
-  for (const auto& attr : x_)
+  if (not this->ymeta) throw RiseException("The target attribute must be nominal");
+  is_real.resize(xmeta.size());
+  slots.resize(xmeta.size());
+  for (int column = 0; column < xmeta.size(); ++column)
   {
-    if (not first) oss << ',';
-    oss << S(attr);
-    first = false;
+    if (auto rmeta = std::dynamic_pointer_cast<RealAttributeMeta>(xmeta[column]))
+    {
+      is_real[column] = true;
+      slots[column] = real_columns.size();
+      real_columns.push_back(column);
+      real_meta.push_back(rmeta.get());
+    }
+    else if (auto nmeta = std::dynamic_pointer_cast<NominalAttributeMeta>(xmeta[column]))
+    {
+      slots[column] = nominal_columns.size();
+      nominal_columns.push_back(column);
+      nominal_meta.push_back(nmeta.get());
+    }
+    else throw RiseException("Unknown type of attribute: " + xmeta[column]->get_name());
   }
-  oss << "], y=" << S(y_);
-  return oss.str();
 }
 
 // Free methods' implementation
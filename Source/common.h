@@ -1,6 +1,7 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#include <cstdint>
 #include <exception>
 #include <map>
 #include <memory>
@@ -11,20 +12,15 @@
 #include <utility>
 #include <vector>
 
-#define S(ptr) (ptr ? ptr->to_str() : "?")
-
 namespace rise
 {
 
 class Stringifiable;
 class RiseException;
-class Attribute;
-class RealAttribute;
-class NominalAttribute;
 class AttributeMeta;
 class RealAttributeMeta;
 class NominalAttributeMeta;
-class Instance;
+struct Schema;
 typedef std::pair<std::string, std::string> CategoryPair;
 
 class Stringifiable
@@ -49,63 +45,6 @@ class RiseException : public std::exception
     std::string msg_;
 };
 
-class Attribute : public Stringifiable
-{
-  public:
-
-    typedef std::shared_ptr<Attribute> Ptr;
-
-    static Ptr create(void) { return Ptr(); }
-
-    virtual bool operator==(const Attribute& other) const = 0;
-
-    virtual ~Attribute() {}
-};
-
-class RealAttribute : public Attribute
-{
-  public:
-
-    typedef std::shared_ptr<RealAttribute> Ptr;
-
-    static Ptr create(double value);
-
-    static Ptr create(const std::string& value);
-
-    RealAttribute(double number) : number_(number) {}
-
-    double get_number() const { return number_; }
-
-    virtual bool operator==(const Attribute& other) const override;
-
-    virtual std::string to_str() const { return std::to_string(number_); }
-
-  private:
-
-    double number_;
-};
-
-class NominalAttribute: public Attribute
-{
-  public:
-
-    typedef std::shared_ptr<NominalAttribute> Ptr;
-
-    static Ptr create(const std::string& value);
-
-    NominalAttribute(const std::string& category) : category_(category) {}
-
-    const std::string& get_category() const { return category_; }
-
-    virtual bool operator==(const Attribute& other) const override;
-
-    virtual std::string to_str() const { return category_; }
-
-  private:
-
-    std::string category_;
-};
-
 class AttributeMeta : public Stringifiable
 {
   public:
@@ -116,6 +55,9 @@ class AttributeMeta : public Stringifiable
 
     const std::string& get_name() const { return name_; }
 
+    // deep copy, so the copy can be modified independently (e.g. its lookup table)
+    virtual Ptr clone() const = 0;
+
     virtual ~AttributeMeta() {}
 
   private:
@@ -141,6 +83,11 @@ class RealAttributeMeta : public AttributeMeta
 
     void set_upper_bound(double up) { upper_bound_ = up; }
 
+    virtual AttributeMeta::Ptr clone() const override
+    {
+      return std::make_shared<RealAttributeMeta>(*this);
+    }
+
     virtual std::string to_str() const override;
 
   private:
@@ -154,46 +101,67 @@ class NominalAttributeMeta : public AttributeMeta
 
     typedef std::shared_ptr<NominalAttributeMeta> Ptr;
 
-    NominalAttributeMeta(const std::string& name) : AttributeMeta(name) {}
-
-    const std::set<std::string>& get_domain() const { return domain_; }
+    // code used to represent missing (or unknown) categories
+    static constexpr uint32_t MISSING = 0xffffffff;
 
-    void set_domain(const std::set<std::string>& domain) { domain_ = domain; }
+    NominalAttributeMeta(const std::string& name) : AttributeMeta(name) {}
 
-    void set_lookup(const std::map<CategoryPair, double>& lu) { distance_lu_ = lu; }
+    // categories sorted alphabetically; the code of a category is its position
+    const std::vector<std::string>& get_domain() const { return domain_; }
 
-    double lookup_distance(const std::string& c1, const std::string& c2) const;
+    void set_domain(const std::set<std::string>& domain);
 
-    virtual std::string to_str() const override;
+    uint32_t get_domain_size() const { return domain_.size(); }
 
-  private:
+    uint32_t get_code(const std::string& category) const;
 
-    std::set<std::string> domain_;
-    std::map<CategoryPair, double> distance_lu_;
-};
+    const std::string& get_category(uint32_t code) const { return domain_[code]; }
 
-class Instance : public Stringifiable
-{
-  public:
-
-    Instance(int index, const std::vector<Attribute::Ptr>& x, const Attribute::Ptr& y)
-      : index_(index), x_(x), y_(y) {}
+    // dense K x K table (K being the domain size) indexed by category codes
+    const std::vector<double>& get_lookup() const { return distance_lu_; }
 
-    int get_index() const { return index_; }
+    void set_lookup(const std::vector<double>& lu);
 
-    const std::vector<Attribute::Ptr>& get_x() const { return x_; }
+    double lookup_distance(const std::string& c1, const std::string& c2) const;
 
-    const Attribute::Ptr& get_y() const { return y_; }
+    // both codes must be valid (i.e. neither missing nor out of the domain)
+    double lookup_distance(uint32_t c1, uint32_t c2) const
+    {
+      return distance_lu_[c1*domain_.size() + c2];
+    }
 
-    const std::string& get_class() const;
+    virtual AttributeMeta::Ptr clone() const override
+    {
+      return std::make_shared<NominalAttributeMeta>(*this);
+    }
 
     virtual std::string to_str() const override;
 
   private:
 
-    int index_;
-    std::vector<Attribute::Ptr> x_;
-    Attribute::Ptr y_;
+    std::vector<std::string> domain_;
+    std::vector<double> distance_lu_;
+};
+
+/*
+ * Metainformation of all the attributes of a dataframe, with the x attributes
+ * grouped by type so rules can keep their conditions in compact arrays (one
+ * for the real attributes and another one for the nominal ones).
+ */
+struct Schema
+{
+  typedef std::shared_ptr<const Schema> Ptr;
+
+  Schema(const std::vector<AttributeMeta::Ptr>& xmeta, const AttributeMeta::Ptr& ymeta);
+
+  std::vector<AttributeMeta::Ptr> xmeta;
+  NominalAttributeMeta::Ptr ymeta;
+  std::vector<int> real_columns;
+  std::vector<int> nominal_columns;
+  std::vector<const RealAttributeMeta*> real_meta;
+  std::vector<const NominalAttributeMeta*> nominal_meta;
+  std::vector<bool> is_real;
+  std::vector<int> slots; // position of each x column in real_columns/nominal_columns
 };
 
 template <class Container>
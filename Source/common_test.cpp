@@ -1,18 +1,20 @@
+
 #include "common.h"
 
 #include <iostream>
 
 int main(int argc, char* argv[])
 {
-  auto attr1 = rise::RealAttribute::create(5.0);
-  auto attr2 = rise::RealAttribute::create("5.0");
-  auto attr3 = rise::RealAttribute::create("?");
-  auto attr4 = rise::NominalAttribute::create("sunny");
-  std::cout << "attr1: " << S(attr1) << std::endl;
-  std::cout << "attr2: " << S(attr2) << std::endl;
-  std::cout << "attr3: " << S(attr3) << std::endl;
-  std::cout << "attr4: " << S(attr4) << std::endl;
+  auto rmeta = std::make_shared<rise::RealAttributeMeta>("temperature");
+  rmeta->set_lower_bound(-5.0);
+  rmeta->set_upper_bound(40.0);
+  auto nmeta = std::make_shared<rise::NominalAttributeMeta>("outlook");
+  nmeta->set_domain({"sunny", "overcast", "rainy"});
+  std::cout << "rmeta: " << *rmeta << std::endl;
+  std::cout << "nmeta: " << *nmeta << std::endl;
+  std::cout << "code(rainy): " << nmeta->get_code("rainy") << std::endl;
+  std::cout << "category(2): " << nmeta->get_category(2) << std::endl;
+  std::cout << "code(?) is missing: " <<
+    (nmeta->get_code("?") == rise::NominalAttributeMeta::MISSING) << std::endl;
 }
 
-
-
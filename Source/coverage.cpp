@@ -0,0 +1,151 @@
+#include "coverage.h"
+#include <algorithm>
+#include <cmath>
+
+namespace rise
+{
+
+namespace /* utils for internal usage */
+{
+
+inline void set_bit(Bitset& bits, int row)
+{
+  bits[row/64] |= uint64_t(1) << (row%64);
+}
+
+} /* end anonymous namespace */
+
+// CoverageIndex's methods
+
+void CoverageIndex::build(const Schema& schema,
+    const std::vector<std::vector<double>>& reals,
+    const std::vector<std::vector<uint32_t>>& codes,
+    const std::vector<uint32_t>& classes)
+{
+  build_sets(schema, reals, codes, classes);
+  for (int column : schema.real_columns)
+  {
+    std::vector<int>& rows = sorted_rows_[column];
+    for (int row = 0; row < n_rows_; ++row)
+    {
+      if (not std::isnan(reals[column][row])) rows.push_back(row);
+    }
+    const std::vector<double>& values = reals[column];
+    std::stable_sort(rows.begin(), rows.end(),
+        [&values](int r1, int r2) { return values[r1] < values[r2]; });
+    sorted_values_[column].resize(rows.size());
+    for (int idx = 0; idx < rows.size(); ++idx) sorted_values_[column][idx] = values[rows[idx]];
+  }
+}
+
+void CoverageIndex::build(const Schema& schema, const CoverageIndex& source,
+    const std::vector<int>& rows,
+    const std::vector<std::vector<double>>& reals,
+    const std::vector<std::vector<uint32_t>>& codes,
+    const std::vector<uint32_t>& classes)
+{
+  /* rows with equal values may end up in a different order than with a stable
+   * sort, which does not matter since they are only turned into bitsets */
+  build_sets(schema, reals, codes, classes);
+  std::vector<int> new_rows(source.n_rows_, -1);
+  for (int idx = 0; idx < rows.size(); ++idx) new_rows[rows[idx]] = idx;
+  for (int column : schema.real_columns)
+  {
+    std::vector<int>& sorted_rows = sorted_rows_[column];
+    std::vector<double>& sorted_values = sorted_values_[column];
+    const std::vector<int>& source_rows = source.sorted_rows_[column];
+    const std::vector<double>& source_values = source.sorted_values_[column];
+    for (int idx = 0; idx < source_rows.size(); ++idx)
+    {
+      int row = new_rows[source_rows[idx]];
+      if (row < 0) continue;
+      sorted_rows.push_back(row);
+      sorted_values.push_back(source_values[idx]);
+    }
+  }
+}
+
+void CoverageIndex::build_sets(const Schema& schema,
+    const std::vector<std::vector<double>>& reals,
+    const std::vector<std::vector<uint32_t>>& codes,
+    const std::vector<uint32_t>& classes)
+{
+  n_rows_ = classes.size();
+  int n_words = (n_rows_ + 63)/64;
+  all_.assign(n_words, ~uint64_t(0));
+  if (n_rows_%64) all_.back() = (uint64_t(1) << (n_rows_%64)) - 1;
+  nominal_.assign(schema.xmeta.size(), std::vector<Bitset>());
+  values_.assign(schema.xmeta.size(), std::vector<double>());
+  sorted_values_.assign(schema.xmeta.size(), std::vector<double>());
+  sorted_rows_.assign(schema.xmeta.size(), std::vector<int>());
+  for (int slot = 0; slot < schema.nominal_columns.size(); ++slot)
+  {
+    int column = schema.nominal_columns[slot];
+    std::vector<Bitset>& rows = nominal_[column];
+    rows.assign(schema.nominal_meta[slot]->get_domain_size(), Bitset(n_words, 0));
+    for (int row = 0; row < n_rows_; ++row)
+    {
+      uint32_t code = codes[column][row];
+      if (code != NominalAttributeMeta::MISSING) set_bit(rows[code], row);
+    }
+  }
+  for (int column : schema.real_columns) values_[column] = reals[column];
+  classes_.assign(schema.ymeta->get_domain_size(), Bitset(n_words, 0));
+  class_counts_.assign(schema.ymeta->get_domain_size(), 0);
+  for (int row = 0; row < n_rows_; ++row)
+  {
+    if (classes[row] == NominalAttributeMeta::MISSING) continue;
+    set_bit(classes_[classes[row]], row);
+    ++class_counts_[classes[row]];
+  }
+}
+
+void CoverageIndex::intersect_interval(int column, double lo, double up, Bitset& bits,
+    Bitset& scratch) const
+{
+  const std::vector<double>& values = sorted_values_[column];
+  const std::vector<int>& rows = sorted_rows_[column];
+  auto first = std::lower_bound(values.begin(), values.end(), lo);
+  auto last = std::upper_bound(first, values.end(), up);
+  if (last - first > count(bits))
+  {
+    /* fewer rows in bits than in the interval: check them one by one */
+    for (int word = 0; word < bits.size(); ++word)
+    {
+      uint64_t remaining = bits[word];
+      while (remaining)
+      {
+        int bit = __builtin_ctzll(remaining);
+        remaining &= remaining - 1;
+        double number = values_[column][64*word + bit];
+        if (not (number >= lo and number <= up)) bits[word] &= ~(uint64_t(1) << bit);
+      }
+    }
+    return;
+  }
+  scratch.assign(bits.size(), 0);
+  for (int idx = first - values.begin(); idx < last - values.begin(); ++idx)
+  {
+    set_bit(scratch, rows[idx]);
+  }
+  for (int word = 0; word < bits.size(); ++word) bits[word] &= scratch[word];
+}
+
+// Free methods' implementation
+
+int count(const Bitset& bits)
+{
+  int n = 0;
+  for (uint64_t word : bits) n += __builtin_popcountll(word);
+  return n;
+}
+
+int count_intersection(const Bitset& b1, const Bitset& b2)
+{
+  int n = 0;
+  for (int word = 0; word < b1.size(); ++word) n += __builtin_popcountll(b1[word] & b2[word]);
+  return n;
+}
+
+} /* end namespace rise */
+
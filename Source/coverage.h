@@ -0,0 +1,87 @@
+#ifndef COVERAGE_H
+#define COVERAGE_H
+
+#include "common.h"
+
+namespace rise
+{
+
+class CoverageIndex;
+
+/*
+ * Sets of rows are bitsets: a vector of 64-bit words where bit (row%64) of
+ * word (row/64) tells whether row belongs to the set. Bits past the last row
+ * are always 0.
+ */
+typedef std::vector<uint64_t> Bitset;
+
+int count(const Bitset& bits);
+
+int count_intersection(const Bitset& b1, const Bitset& b2);
+
+/*
+ * Precomputed sets of rows of a (columnar) dataframe: one bitset per category
+ * of every nominal attribute (and of the target), and the rows of every real
+ * attribute sorted by value, so the rows in an interval are found by binary
+ * search. Missing values do not belong to any set.
+ */
+class CoverageIndex
+{
+  public:
+
+    CoverageIndex() : n_rows_(0) {}
+
+    void build(const Schema& schema,
+               const std::vector<std::vector<double>>& reals,
+               const std::vector<std::vector<uint32_t>>& codes,
+               const std::vector<uint32_t>& classes);
+
+    /*
+     * Same as build, for the data made of the given rows of the data of source
+     * (row idx being rows[idx] of source). The rows of each real attribute are
+     * taken in the order of source instead of being sorted again.
+     */
+    void build(const Schema& schema, const CoverageIndex& source, const std::vector<int>& rows,
+               const std::vector<std::vector<double>>& reals,
+               const std::vector<std::vector<uint32_t>>& codes,
+               const std::vector<uint32_t>& classes);
+
+    int get_number_of_rows() const { return n_rows_; }
+
+    int get_number_of_words() const { return all_.size(); }
+
+    const Bitset& get_all() const { return all_; }
+
+    // rows whose (nominal) column has category code
+    const Bitset& get_rows(int column, uint32_t code) const { return nominal_[column][code]; }
+
+    const Bitset& get_class_rows(uint32_t code) const { return classes_[code]; }
+
+    int get_class_count(uint32_t code) const { return class_counts_[code]; }
+
+    // bits &= rows whose (real) column is in [lo, up] (scratch is overwritten)
+    void intersect_interval(int column, double lo, double up, Bitset& bits,
+                            Bitset& scratch) const;
+
+  private:
+
+    // everything but the sorted rows of the real attributes
+    void build_sets(const Schema& schema,
+                    const std::vector<std::vector<double>>& reals,
+                    const std::vector<std::vector<uint32_t>>& codes,
+                    const std::vector<uint32_t>& classes);
+
+    int n_rows_;
+    Bitset all_;
+    std::vector<std::vector<Bitset>> nominal_;  // [column][code]
+    std::vector<Bitset> classes_;               // [class code]
+    std::vector<int> class_counts_;
+    std::vector<std::vector<double>> values_;         // [column][row]
+    std::vector<std::vector<double>> sorted_values_;  // [column], without NaNs
+    std::vector<std::vector<int>> sorted_rows_;       // [column]
+};
+
+} /* end namespace rise */
+
+#endif
+
@@ -0,0 +1,61 @@
+#include "dataframe.h"
+#include "rules.h"
+#include <cstdlib>
+#include <iostream>
+
+int main(int argc, char* argv[])
+{
+  srand(42);
+  if (argc != 2)
+  {
+    std::cerr << "Usage: coverage_test datasetname\n";
+    return -1;
+  }
+  try
+  {
+    std::string datafile = std::string("../Data/") + argv[1] + '/' + argv[1] + ".data";
+    std::string metafile = std::string("../Data/") + argv[1] + '/' + argv[1] + ".meta";
+    rise::Dataframe df(datafile, metafile);
+    df.shuffle();
+    /* compares the rows covered according to the coverage index with the ones
+     * found by checking every instance */
+    auto count_mismatches = [](const rise::Dataframe& df)
+    {
+      const std::vector<rise::Instance>& instances = df.get_instances();
+      int mismatches = 0;
+      for (int idx = 0; idx < instances.size(); ++idx)
+      {
+        auto rule = std::make_shared<rise::Rule>(instances[idx]);
+        for (int step = 0; step < 3; ++step)
+        {
+          rule->evaluate_rule(df);
+          for (const rise::Instance& instance : instances)
+          {
+            int row = instance.get_row();
+            bool covered = (rule->get_covered()[row/64] >> (row%64)) & 1;
+            if (covered != rule->covers(instance)) ++mismatches;
+          }
+          rule = rule->adapt(instances[rand() % instances.size()]);
+        }
+      }
+      return mismatches;
+    };
+    std::cout << "#Mismatches with covers(): " << count_mismatches(df) << std::endl;
+    /* the index of a fold is derived from the one of the whole dataframe */
+    rise::Dataframe train, val;
+    df.split(0, 10, train, val);
+    std::cout << "#Mismatches with covers() in a fold: " << count_mismatches(train) << std::endl;
+    std::cout << "Rows of the 1st category of the 1st nominal attribute: ";
+    const rise::Schema& schema = *df.get_schema();
+    if (not schema.nominal_columns.empty())
+    {
+      std::cout << rise::count(df.get_coverage_index().get_rows(schema.nominal_columns[0], 0));
+    }
+    std::cout << std::endl;
+  }
+  catch (rise::RiseException& ex)
+  {
+    std::cerr << ex.what() << '\n';
+  }
+}
+
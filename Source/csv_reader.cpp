@@ -1,7 +1,14 @@
 #include "csv_reader.h"
 #include <cctype>
+#include <cerrno>
+#include <cstdlib>
 #include <iostream>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 namespace rise
 {
 
@@ -31,6 +38,28 @@ void split(const std::string& line, CsvRow& row, char delim=',')
   row.push_back(line.substr(pos));
 }
 
+// blanks (as isblank in the "C" locale) and digits
+inline bool is_blank(char c) { return c == ' ' or c == '\t'; }
+
+inline bool is_digit(char c) { return c >= '0' and c <= '9'; }
+
+// powers of 10 that are exactly representable as doubles
+const double EXACT_POWERS_OF_10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+double parse_real_slow(const StringRef& field)
+{
+  std::string str = field.str();
+  char* end;
+  errno = 0;
+  double number = std::strtod(str.c_str(), &end);
+  if (end == str.c_str()) throw RiseException("Cannot parse real value: " + str);
+  if (errno == ERANGE) throw RiseException("Real value out of range: " + str);
+  return number;
+}
+
 } /* end anonymous namespace */
 
 CsvReader::CsvReader(const std::string& filename, char delim)
@@ -54,6 +83,162 @@ bool CsvReader::next_row(CsvRow& row)
   return (bool) in_;
 }
 
-} /* end namespace rise */
+// StringRefHash's methods
+
+std::size_t StringRefHash::operator()(const StringRef& ref) const
+{
+  // FNV-1a
+  std::size_t h = 14695981039346656037ULL;
+  for (std::size_t idx = 0; idx < ref.size; ++idx)
+  {
+    h ^= (unsigned char) ref.data[idx];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+// MappedFile's methods
+
+MappedFile::MappedFile(const std::string& filename) : data_(nullptr), size_(0)
+{
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) throw RiseException(std::string("Error opening ") + filename);
+  struct stat st;
+  if (fstat(fd, &st) < 0 or not S_ISREG(st.st_mode))
+  {
+    close(fd);
+    throw RiseException(std::string("Error opening ") + filename);
+  }
+  size_ = st.st_size;
+  if (size_ > 0)
+  {
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+      close(fd);
+      throw RiseException(std::string("Error mapping ") + filename);
+    }
+    madvise(data, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(data);
+  }
+  close(fd); // the mapping keeps the file open
+}
+
+MappedFile::~MappedFile()
+{
+  if (data_) munmap(const_cast<char*>(data_), size_);
+}
 
+// CsvScanner's methods
 
+CsvScanner::CsvScanner(const char* begin, const char* end, char delim)
+  : pos_(begin), end_(end), delim_(delim) {}
+
+bool CsvScanner::next_row(std::vector<StringRef>& row)
+{
+  row.clear();
+  int n_cleaned = 0;
+  while (row.empty() and pos_ < end_)
+  {
+    const char* line_end = static_cast<const char*>(std::memchr(pos_, '\n', end_ - pos_));
+    if (not line_end) line_end = end_;
+    const char* line = pos_;
+    pos_ = line_end < end_? line_end + 1 : end_;
+    bool blank_line = true;
+    for (const char* p = line; p < line_end and blank_line; ++p) blank_line = is_blank(*p);
+    if (blank_line) continue;
+    if (is_blank(delim_))
+    {
+      // the delimiter would be removed with the blanks
+      row.push_back(clean(line, line_end, n_cleaned));
+      continue;
+    }
+    const char* field = line;
+    const char* next;
+    while ((next = static_cast<const char*>(std::memchr(field, delim_, line_end - field))))
+    {
+      row.push_back(clean(field, next, n_cleaned));
+      field = next + 1;
+    }
+    row.push_back(clean(field, line_end, n_cleaned));
+  }
+  return not row.empty();
+}
+
+StringRef CsvScanner::clean(const char* begin, const char* end, int& n_cleaned)
+{
+  while (begin < end and is_blank(*begin)) ++begin;
+  while (end > begin and is_blank(*(end-1))) --end;
+  const char* p = begin;
+  while (p < end and not is_blank(*p)) ++p;
+  if (p == end) return StringRef(begin, end - begin);
+  /* blanks between other characters */
+  if (n_cleaned == cleaned_.size()) cleaned_.push_back(std::string());
+  std::string& cleaned = cleaned_[n_cleaned++];
+  cleaned.clear();
+  for (p = begin; p < end; ++p)
+  {
+    if (not is_blank(*p)) cleaned.push_back(*p);
+  }
+  return StringRef(cleaned);
+}
+
+// Free methods' implementation
+
+double parse_real(const StringRef& field)
+{
+  const char* p = field.data;
+  const char* end = p + field.size;
+  bool negative = false;
+  if (p < end and (*p == '-' or *p == '+')) negative = *p++ == '-';
+  uint64_t mantissa = 0;
+  int n_digits = 0;      // significant digits in mantissa
+  int exponent = 0;
+  bool any_digit = false;
+  for (; p < end and is_digit(*p); ++p)
+  {
+    any_digit = true;
+    if (mantissa == 0 and *p == '0') continue;
+    if (++n_digits > 19) return parse_real_slow(field);
+    mantissa = 10*mantissa + (*p - '0');
+  }
+  if (p < end and *p == '.')
+  {
+    for (++p; p < end and is_digit(*p); ++p)
+    {
+      any_digit = true;
+      --exponent;
+      if (mantissa == 0 and *p == '0') continue;
+      if (++n_digits > 19) return parse_real_slow(field);
+      mantissa = 10*mantissa + (*p - '0');
+    }
+  }
+  if (any_digit and p < end and (*p == 'e' or *p == 'E'))
+  {
+    const char* q = p + 1;
+    bool negative_exponent = false;
+    if (q < end and (*q == '-' or *q == '+')) negative_exponent = *q++ == '-';
+    if (q == end or not is_digit(*q)) return parse_real_slow(field);
+    int explicit_exponent = 0;
+    for (; q < end and is_digit(*q); ++q)
+    {
+      if (explicit_exponent > 10000) return parse_real_slow(field);
+      explicit_exponent = 10*explicit_exponent + (*q - '0');
+    }
+    exponent += negative_exponent? -explicit_exponent : explicit_exponent;
+    p = q;
+  }
+  /* anything else (trailing characters, hexadecimal numbers, inf, nan, big
+   * mantissas or exponents) is left to strtod */
+  if (not any_digit or p != end or mantissa > (uint64_t(1) << 53) or
+      exponent < -22 or exponent > 22)
+  {
+    return parse_real_slow(field);
+  }
+  double number = mantissa;
+  if (exponent < 0) number /= EXACT_POWERS_OF_10[-exponent];
+  else number *= EXACT_POWERS_OF_10[exponent];
+  return negative? -number : number;
+}
+
+} /* end namespace rise */
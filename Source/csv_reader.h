@@ -1,8 +1,10 @@
-#ifndef CSV_REkADER_H
+#ifndef CSV_READER_H
 #define CSV_READER_H
 
 #include "common.h"
 
+#include <cstring>
+#include <deque>
 #include <fstream>
 #include <string>
 #include <vector>
@@ -13,6 +15,10 @@ namespace rise
 
 typedef std::vector<std::string> CsvRow;
 class CsvReader;
+struct StringRef;
+struct StringRefHash;
+class MappedFile;
+class CsvScanner;
 
 class CsvReader
 {
@@ -27,6 +33,99 @@ class CsvReader
     char delim_;
 };
 
+/*
+ * Non-owning reference to a sequence of characters (what std::string_view
+ * is in C++17).
+ */
+struct StringRef
+{
+  const char* data;
+  std::size_t size;
+
+  StringRef() : data(nullptr), size(0) {}
+
+  StringRef(const char* data, std::size_t size) : data(data), size(size) {}
+
+  explicit StringRef(const std::string& str) : data(str.data()), size(str.size()) {}
+
+  std::string str() const { return std::string(data, size); }
+
+  bool operator==(const StringRef& other) const
+  {
+    return size == other.size and std::memcmp(data, other.data, size) == 0;
+  }
+
+  bool operator==(const char* other) const
+  {
+    return size == std::strlen(other) and std::memcmp(data, other, size) == 0;
+  }
+};
+
+struct StringRefHash
+{
+  std::size_t operator()(const StringRef& ref) const;
+};
+
+/*
+ * Read-only memory mapping of a whole file.
+ */
+class MappedFile
+{
+  public:
+
+    explicit MappedFile(const std::string& filename);
+
+    MappedFile(const MappedFile& other) = delete;
+
+    MappedFile& operator=(const MappedFile& other) = delete;
+
+    ~MappedFile();
+
+    const char* begin() const { return data_; }
+
+    const char* end() const { return data_ + size_; }
+
+    std::size_t size() const { return size_; }
+
+  private:
+
+    const char* data_;
+    std::size_t size_;
+};
+
+/*
+ * Splits a buffer in rows and fields following the same rules as CsvReader
+ * (blanks are removed and blank lines are skipped) without copying it: the
+ * fields are slices of the buffer, except for the (rare) ones with blanks
+ * between other characters, which are copied. Fields are valid until the next
+ * call to next_row.
+ */
+class CsvScanner
+{
+  public:
+
+    CsvScanner(const char* begin, const char* end, char delim=',');
+
+    bool next_row(std::vector<StringRef>& row);
+
+  private:
+
+    StringRef clean(const char* begin, const char* end, int& n_cleaned);
+
+    const char* pos_;
+    const char* end_;
+    char delim_;
+    std::deque<std::string> cleaned_; // stable addresses (unlike a vector)
+};
+
+/*
+ * Parses a real number as std::stod would do (parsing as many characters as
+ * possible), but without copying the characters in the common case (plain
+ * decimal numbers with up to 19 significant digits and small exponents,
+ * whose correctly rounded value is computed exactly with a single operation).
+ */
+double parse_real(const StringRef& field);
+
 
 } /* end namespace rise */
 
@@ -24,6 +24,29 @@ int main(int argc, char* argv[])
       //std::cout << rise::container2str(row) << std::endl;
     }
     std::cout << "#Records: " << nrecords << "; #Attributes: " << columns << std::endl;
+    /* the scanner must split the file in the same fields */
+    rise::CsvReader reader2(argv[1]);
+    rise::MappedFile file(argv[1]);
+    rise::CsvScanner scanner(file.begin(), file.end());
+    std::vector<rise::StringRef> fields;
+    int mismatches = 0;
+    nrecords = 0;
+    while (scanner.next_row(fields))
+    {
+      nrecords += 1;
+      if (not reader2.next_row(row) or row.size() != fields.size()) ++mismatches;
+      else for (int idx = 0; idx < row.size(); ++idx)
+      {
+        if (not (fields[idx] == rise::StringRef(row[idx]))) ++mismatches;
+      }
+    }
+    if (reader2.next_row(row)) ++mismatches;
+    std::cout << "#Records (mapped file): " << nrecords << "; #Mismatches: " << mismatches << std::endl;
+    for (const char* number : {"3.14", "-0.5", "00202", "1e-3", ".5", "1.", "12abc", "1e300", "0x1p3"})
+    {
+      std::cout << number << " -> " << rise::parse_real(rise::StringRef(number, std::strlen(number)))
+                << " (stod: " << std::stod(number) << ')' << std::endl;
+    }
   }
   catch (rise::RiseException& ex)
   {
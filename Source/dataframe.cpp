@@ -1,9 +1,15 @@
 #include "dataframe.h"
+#include "parallel.h"
+#include "serialization.h"
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <limits>
 #include <set>
+#include <unordered_map>
 
 namespace rise
 {
@@ -11,69 +17,198 @@ namespace rise
 namespace /* Utils for internal usage */
 {
 
-void push_column(std::vector<CsvRow>& table, int column)
+/*
+ * Codes the categories of a nominal column in order of appearance while the
+ * data is read (the codes of the sorted domain are only known at the end).
+ * Missing values ("?") are coded as NominalAttributeMeta::MISSING.
+ */
+class CategoryDictionary
 {
-  for (CsvRow& row : table)
+  public:
+
+    CategoryDictionary() {}
+
+    // the keys of codes_ point to categories_, so copies would be wrong
+    CategoryDictionary(const CategoryDictionary& other) = delete;
+
+    CategoryDictionary(CategoryDictionary&& other) = default;
+
+    uint32_t encode(const StringRef& category)
+    {
+      if (category == "?") return NominalAttributeMeta::MISSING;
+      auto it = codes_.find(category);
+      if (it != codes_.end()) return it->second;
+      categories_.push_back(category.str());
+      uint32_t code = categories_.size() - 1;
+      codes_[StringRef(categories_.back())] = code;
+      return code;
+    }
+
+    // in order of appearance
+    const std::deque<std::string>& get_categories() const { return categories_; }
+
+  private:
+
+    std::deque<std::string> categories_; // stable addresses for the keys of codes_
+    std::unordered_map<StringRef, uint32_t, StringRefHash> codes_;
+};
+
+/*
+ * Columns of the rows of a chunk of the data file (the target is the last
+ * one), with categories coded by the dictionaries of the chunk.
+ */
+struct Chunk
+{
+  const char* begin;
+  const char* end;
+  std::vector<std::vector<double>> reals;
+  std::vector<std::vector<uint32_t>> codes;
+  std::vector<CategoryDictionary> dictionaries;
+  int first_row;
+};
+
+// chunks are only split among threads when they are big enough
+const std::size_t MIN_CHUNK_SIZE = 1 << 16;
+
+void read_chunk(const Schema& schema, char delim, int target_column, Chunk& chunk)
+{
+  int n_columns = schema.xmeta.size() + 1;
+  int y_column = schema.xmeta.size();
+  // column of every field of the file (the target goes after the x columns)
+  std::vector<int> columns(n_columns);
+  for (int field = 0; field < n_columns; ++field)
   {
-    for (int idx = column+1; idx < row.size(); ++idx)
+    columns[field] = field < target_column? field : field == target_column? y_column : field-1;
+  }
+  chunk.reals.assign(n_columns, std::vector<double>());
+  chunk.codes.assign(n_columns, std::vector<uint32_t>());
+  chunk.dictionaries.resize(n_columns);
+  CsvScanner scanner(chunk.begin, chunk.end, delim);
+  std::vector<StringRef> row;
+  while (scanner.next_row(row))
+  {
+    if (row.size() != n_columns) throw RiseException("Inconsistent number of columns");
+    for (int field = 0; field < n_columns; ++field)
     {
-      std::swap(row[idx-1], row[idx]);
+      int column = columns[field];
+      const StringRef& value = row[field];
+      if (column < y_column and schema.is_real[column])
+      {
+        chunk.reals[column].push_back(value == "?"? std::numeric_limits<double>::quiet_NaN() :
+                                                   parse_real(value));
+      }
+      else chunk.codes[column].push_back(chunk.dictionaries[column].encode(value));
     }
   }
 }
 
-void intersect(const std::set<int>& s1, const std::set<int>& s2, std::set<int>& intersection)
+/*
+ * Snapshots of dataframes are binary files (see BinaryWriter) with the number
+ * of records (uint64_t), the metadata of the attributes and the columns: one
+ * array (double or uint32_t) per x attribute, the classes (array of uint32_t)
+ * and the original indices (array of int32_t).
+ */
+const char SNAPSHOT_MAGIC[8] = {'R', 'I', 'S', 'E', 'D', 'F', '\0', '\0'};
+const uint32_t SNAPSHOT_VERSION = 1;
+
+} /* end anonymous namespace */
+
+// Instance's methods
+
+const std::string& Instance::get_class() const
+{
+  auto cmeta = std::static_pointer_cast<NominalAttributeMeta>(df_->get_ymeta());
+  return cmeta->get_category(get_class_code());
+}
+
+std::string Instance::to_str() const
 {
-  intersection.clear();
-  const std::set<int>& s1_ = s1.size() < s2.size()? s1 : s2;
-  const std::set<int>& s2_ = &s1_ != &s1? s1 : s2;
-  for (int x : s1_)
+  std::ostringstream oss;
+  oss << get_index() << ": x=[";
+  for (int column = 0; column < df_->get_number_of_x_attributes(); ++column)
   {
-    if (s2_.count(x)) intersection.insert(x);
+    if (column > 0) oss << ',';
+    if (is_missing(column)) oss << '?';
+    else if (df_->is_real(column)) oss << std::to_string(get_real(column));
+    else
+    {
+      auto nmeta = std::static_pointer_cast<NominalAttributeMeta>(df_->get_xmeta()[column]);
+      oss << nmeta->get_category(get_code(column));
+    }
   }
+  oss << "], y=" << get_class();
+  return oss.str();
 }
 
-} /* end anonymous namespace */
+// Dataframe's methods
 
 Dataframe::Dataframe() {}
 
-Dataframe::Dataframe(const std::string& datafile, const std::string& metafile, char delim)
+Dataframe::Dataframe(const std::string& datafile, const std::string& metafile, char delim,
+    int num_threads)
+{
+  int target_column = read_metadata(metafile);
+  MappedFile file(datafile);
+  /* transform raw data to internal (columnar) representation, filling the
+   * metainformation about nominal attributes (i.e. domains) */
+  read_database(file, delim, target_column, num_threads);
+  /* fill metainformation about real attributes (i.e. bounds) */
+  fill_bounds();
+}
+
+Dataframe::Dataframe(const std::string& datafile, const std::string& metafile,
+    const Schema::Ptr& schema, char delim, int num_threads)
 {
   int target_column = read_metadata(metafile);
-  CsvReader reader(datafile, delim);
-  std::vector<CsvRow> raw_database;
-  CsvRow row;
-  while (reader.next_row(row))
+  bool same_attributes = xmeta_.size() == schema->xmeta.size() and
+                         ymeta_->get_name() == schema->ymeta->get_name();
+  for (int column = 0; column < xmeta_.size() and same_attributes; ++column)
+  {
+    same_attributes = xmeta_[column]->get_name() == schema->xmeta[column]->get_name() and
+                      is_real(column) == schema->is_real[column];
+  }
+  if (not same_attributes)
   {
-    if (row.size() != xmeta_.size()+1) throw RiseException("Inconsistent number of columns");
-    raw_database.push_back(row);
+    throw RiseException(std::string("The attributes of the metafile do not match: ") + metafile);
   }
-  /* move target column to last column */
-  push_column(raw_database, target_column);
-  /* transform raw data to internal representation */
-  fill_database(raw_database);
-  /* fill metainformation about attributes (i.e. domains) */
-  fill_domains();
+  xmeta_ = schema->xmeta;
+  ymeta_ = schema->ymeta;
+  schema_ = schema;
+  MappedFile file(datafile);
+  read_database(file, delim, target_column, num_threads, true);
 }
 
-void Dataframe::init_lu(NDistance type, double q)
+void Dataframe::init_lu(NDistance type, double q, int num_threads)
 {
-  switch (type)
+  /* each table only depends on its own column and the classes (and each
+   * attribute has its own metadata), so they can be built concurrently */
+  const std::vector<int>& columns = schema_->nominal_columns;
+  lu_times_.assign(columns.size(), 0);
+  parallel_for(columns.size(), num_threads, [&](int slot)
   {
-    case GODEL: init_godel(); break;
-    case SVDM: init_svdm(q); break;
-    case KL: init_kl(); break;
-  }
+    auto start = std::chrono::steady_clock::now();
+    switch (type)
+    {
+      case GODEL: init_godel(columns[slot]); break;
+      case SVDM: init_svdm(columns[slot], q); break;
+      case KL: init_kl(columns[slot]); break;
+    }
+    lu_times_[slot] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  });
 }
 
 int Dataframe::get_number_of_missing_values() const
 {
   int count = 0;
-  for (const Instance& instance : database_)
+  for (int column = 0; column < get_number_of_x_attributes(); ++column)
   {
-    for (const Attribute::Ptr& value : instance.get_x())
+    if (is_real(column))
     {
-      if (not value) ++count;
+      for (double number : reals_[column]) if (std::isnan(number)) ++count;
+    }
+    else
+    {
+      for (uint32_t code : codes_[column]) if (code == NominalAttributeMeta::MISSING) ++count;
     }
   }
   return count;
@@ -81,37 +216,41 @@ int Dataframe::get_number_of_missing_values() const
 
 void Dataframe::shuffle()
 {
-  for (int idx = 0; idx < (int)database_.size(); ++idx)
+  std::vector<int> rows(get_number_of_records());
+  for (int idx = 0; idx < (int)rows.size(); ++idx) rows[idx] = idx;
+  for (int idx = 0; idx < (int)rows.size(); ++idx)
   {
-    int jdx = rand() % database_.size();
-    std::swap(database_[idx], database_[jdx]);
+    int jdx = rand() % rows.size();
+    std::swap(rows[idx], rows[jdx]);
   }
+  gather(*this, rows);
 }
 
-void Dataframe::conditional_probs(int column, std::map<CategoryPair, double>& results) const
+void Dataframe::conditional_probs(int column, std::vector<double>& probs) const
 {
-  std::map<std::string, std::set<int>> filt_by_attr;
-  std::map<std::string, std::set<int>> filt_by_class;
-  auto ameta = std::dynamic_pointer_cast<NominalAttributeMeta>(xmeta_[column]);
-  auto cmeta = std::dynamic_pointer_cast<NominalAttributeMeta>(ymeta_);
-  for (const std::string& attr_value : ameta->get_domain())
+  /* contingency table of the categories and the classes, filled in a single
+   * pass over the column (instances of missing class still count for the
+   * total of their category) */
+  const uint32_t n_values = schema_->nominal_meta[schema_->slots[column]]->get_domain_size();
+  const uint32_t n_classes = schema_->ymeta->get_domain_size();
+  std::vector<int> counts(n_values*n_classes, 0);
+  std::vector<int> totals(n_values, 0);
+  const std::vector<uint32_t>& codes = codes_[column];
+  for (int row = 0; row < codes.size(); ++row)
   {
-    filter(column, attr_value, filt_by_attr[attr_value]);
+    uint32_t code = codes[row];
+    if (code == NominalAttributeMeta::MISSING) continue;
+    ++totals[code];
+    if (classes_[row] != NominalAttributeMeta::MISSING) ++counts[code*n_classes + classes_[row]];
   }
-  for (const std::string& class_value : cmeta->get_domain())
+  probs.resize(counts.size());
+  for (uint32_t code = 0; code < n_values; ++code)
   {
-    int y_column = get_number_of_x_attributes() + 1;
-    filter(y_column, class_value, filt_by_class[class_value]);
-  }
-  for (const std::string& attr_value : ameta->get_domain())
-  {
-    for (const std::string& class_value : cmeta->get_domain())
+    for (uint32_t class_code = 0; class_code < n_classes; ++class_code)
     {
-      std::set<int> intersection;
-      intersect(filt_by_attr[attr_value], filt_by_class[class_value], intersection);
-      double num = intersection.size();
-      double den = filt_by_attr[attr_value].size();
-      results[std::make_pair(attr_value, class_value)] = num/den;
+      // NaN (0/0) for categories without instances
+      probs[code*n_classes + class_code] =
+          double(counts[code*n_classes + class_code])/totals[code];
     }
   }
 }
@@ -122,24 +261,81 @@ void Dataframe::split(int fold_idx, int k, Dataframe& train, Dataframe& val) con
   int fold_max_size = n_records / k;
   int val_start = fold_idx*fold_max_size;
   int val_end = fold_idx == k-1? n_records : (fold_idx+1)*fold_max_size;
-  train.database_.clear();
-  val.database_.clear();
-  train.xmeta_ = val.xmeta_ = xmeta_;
-  train.ymeta_ = val.ymeta_ = ymeta_;
-  train.database_.reserve(n_records - (val_end - val_start));
-  val.database_.reserve(val_end - val_start);
-  for (int idx = 0; idx < val_start; ++idx)
-  {
-    train.database_.push_back(database_[idx]);
+  std::vector<int> train_rows, val_rows;
+  train_rows.reserve(n_records - (val_end - val_start));
+  val_rows.reserve(val_end - val_start);
+  for (int idx = 0; idx < val_start; ++idx) train_rows.push_back(idx);
+  for (int idx = val_end; idx < n_records; ++idx) train_rows.push_back(idx);
+  for (int idx = val_start; idx < val_end; ++idx) val_rows.push_back(idx);
+  split(train_rows, val_rows, train, val);
+}
+
+void Dataframe::split(const std::vector<int>& train_rows, const std::vector<int>& val_rows,
+    Dataframe& train, Dataframe& val) const
+{
+  train.clone_metadata(*this);
+  val.xmeta_ = train.xmeta_;
+  val.ymeta_ = train.ymeta_;
+  val.schema_ = train.schema_;
+  train.gather(*this, train_rows);
+  val.gather(*this, val_rows);
+}
+
+void Dataframe::save(const std::string& filename) const
+{
+  BinaryWriter writer(filename, SNAPSHOT_MAGIC, SNAPSHOT_VERSION);
+  writer.write<uint64_t>(get_number_of_records());
+  write_attributes(writer, xmeta_, ymeta_);
+  for (int column = 0; column < xmeta_.size(); ++column)
+  {
+    if (is_real(column)) writer.write_array(reals_[column]);
+    else writer.write_array(codes_[column]);
   }
-  for (int idx = val_end; idx < n_records; ++idx)
+  writer.write_array(classes_);
+  writer.write_array(indices_);
+  writer.close();
+}
+
+void Dataframe::load(const std::string& filename)
+{
+  BinaryReader reader(filename, SNAPSHOT_MAGIC, SNAPSHOT_VERSION);
+  uint64_t n_records = reader.read<uint64_t>();
+  read_attributes(reader, xmeta_, ymeta_);
+  schema_ = std::make_shared<Schema>(xmeta_, ymeta_);
+  reals_.assign(xmeta_.size(), std::vector<double>());
+  codes_.assign(xmeta_.size(), std::vector<uint32_t>());
+  for (int column = 0; column < xmeta_.size(); ++column)
   {
-    train.database_.push_back(database_[idx]);
+    if (is_real(column)) reader.read_array(reals_[column]);
+    else reader.read_array(codes_[column]);
   }
-  for (int idx = val_start; idx < val_end; ++idx)
+  reader.read_array(classes_);
+  reader.read_array(indices_);
+  if (not reader.at_end()) reader.fail("Unexpected data at the end of the snapshot");
+  /* sizes and codes are checked, so a corrupt file cannot yield out of range accesses */
+  bool consistent = classes_.size() == n_records and indices_.size() == n_records;
+  for (int column = 0; column < xmeta_.size() and consistent; ++column)
   {
-    val.database_.push_back(database_[idx]);
+    if (is_real(column)) consistent = reals_[column].size() == n_records;
+    else
+    {
+      consistent = codes_[column].size() == n_records;
+      uint32_t domain_size = schema_->nominal_meta[schema_->slots[column]]->get_domain_size();
+      for (uint32_t code : codes_[column])
+      {
+        if (code >= domain_size and code != NominalAttributeMeta::MISSING) consistent = false;
+      }
+    }
+  }
+  for (uint32_t code : classes_)
+  {
+    if (code >= schema_->ymeta->get_domain_size() and code != NominalAttributeMeta::MISSING)
+    {
+      consistent = false;
+    }
   }
+  if (not consistent) reader.fail("Inconsistent snapshot");
+  reset_instances();
 }
 
 std::string Dataframe::to_str() const
@@ -158,10 +354,10 @@ std::string Dataframe::to_str() const
     oss << "  " << (idx+1) << ". " << *xmeta_[idx] << '\n';
   }
   oss << "  " << (n_attr+1) << ". " << *ymeta_ << " (target) \n";
-  if (database_.size() < 25)
+  if (instances_.size() < 25)
   {
     oss << "Database:\n";
-    for (const Instance& instance : database_)
+    for (const Instance& instance : instances_)
     {
       oss << instance << '\n';
     }
@@ -169,10 +365,10 @@ std::string Dataframe::to_str() const
   else
   {
     oss << "Database excerpt:\n"
-        << database_[0] << '\n'
-        << database_[1] << '\n'
+        << instances_[0] << '\n'
+        << instances_[1] << '\n'
         << "...\n"
-        << database_.back();
+        << instances_.back();
   }
   return oss.str();
 }
@@ -227,170 +423,258 @@ int Dataframe::read_metadata(const std::string& metafile)
     throw RiseException(std::string("Specified target attribute (") + target_attribute +
           ") is not nominal");
   }
+  schema_ = std::make_shared<Schema>(xmeta_, ymeta_);
   return target_column;
 }
 
-void Dataframe::fill_database(const std::vector<CsvRow>& raw_data)
+void Dataframe::clone_metadata(const Dataframe& source)
 {
-  database_.reserve(raw_data.size());
-  for (const CsvRow& row : raw_data)
-  {
-    int idx = database_.size();
-    std::vector<Attribute::Ptr> x;
-    x.reserve(xmeta_.size());
-    Attribute::Ptr y = NominalAttribute::create(row.back());
-    for (int idx = 0; idx < xmeta_.size(); ++idx)
+  xmeta_.clear();
+  for (const AttributeMeta::Ptr& meta : source.xmeta_) xmeta_.push_back(meta->clone());
+  ymeta_ = source.ymeta_->clone();
+  schema_ = std::make_shared<Schema>(xmeta_, ymeta_);
+}
+
+void Dataframe::read_database(const MappedFile& file, char delim, int target_column,
+    int num_threads, bool fixed_domains)
+{
+  /* the file is split in chunks (at the beginning of lines) which are parsed
+   * independently and then concatenated, translating the codes of their
+   * dictionaries to the codes of the (sorted) domains */
+  num_threads = resolve_num_threads(num_threads);
+  int n_chunks = std::min<std::size_t>(4*num_threads, file.size()/MIN_CHUNK_SIZE);
+  if (num_threads == 1 or n_chunks < 1) n_chunks = 1;
+  std::vector<Chunk> chunks(n_chunks);
+  const char* begin = file.begin();
+  for (int idx = 0; idx < n_chunks; ++idx)
+  {
+    const char* end = file.end();
+    if (idx < n_chunks-1)
     {
-      if (std::dynamic_pointer_cast<RealAttributeMeta>(xmeta_[idx]))
+      end = std::max(begin, file.begin() + (file.size()*(idx+1))/n_chunks);
+      const char* line_end = static_cast<const char*>(std::memchr(end, '\n', file.end() - end));
+      end = line_end? line_end + 1 : file.end();
+    }
+    chunks[idx].begin = begin;
+    chunks[idx].end = end;
+    begin = end;
+  }
+  parallel_for(n_chunks, num_threads, [&](int idx)
+  {
+    read_chunk(*schema_, delim, target_column, chunks[idx]);
+  });
+  int n_records = 0;
+  for (Chunk& chunk : chunks)
+  {
+    chunk.first_row = n_records;
+    n_records += chunk.codes.back().size();
+  }
+  /* domains (the target goes after the x columns) */
+  int y_column = xmeta_.size();
+  std::vector<std::vector<std::vector<uint32_t>>> translations(n_chunks,
+      std::vector<std::vector<uint32_t>>(y_column + 1));
+  for (int column = 0; column <= y_column; ++column)
+  {
+    if (column < y_column and is_real(column)) continue;
+    auto nmeta = std::static_pointer_cast<NominalAttributeMeta>(
+        column < y_column? xmeta_[column] : ymeta_);
+    if (not fixed_domains)
+    {
+      std::set<std::string> domain;
+      for (const Chunk& chunk : chunks)
       {
-        x.push_back(RealAttribute::create(row[idx]));
+        const std::deque<std::string>& categories = chunk.dictionaries[column].get_categories();
+        domain.insert(categories.begin(), categories.end());
       }
-      else
+      nmeta->set_domain(domain);
+    }
+    for (int idx = 0; idx < n_chunks; ++idx)
+    {
+      const std::deque<std::string>& categories = chunks[idx].dictionaries[column].get_categories();
+      for (const std::string& category : categories)
       {
-        x.push_back(NominalAttribute::create(row[idx]));
+        translations[idx][column].push_back(nmeta->get_code(category));
       }
     }
-    database_.push_back(Instance(idx, x, y));
   }
-}
-
-void Dataframe::fill_domains()
-{
-  for (int column = 0; column < xmeta_.size()+1; ++column)
+  /* columns */
+  reals_.assign(y_column, std::vector<double>());
+  codes_.assign(y_column, std::vector<uint32_t>());
+  for (int column = 0; column < y_column; ++column)
   {
-    AttributeMeta::Ptr& meta = column < xmeta_.size()? xmeta_[column] : ymeta_;
-    if (auto nmeta = std::dynamic_pointer_cast<NominalAttributeMeta>(meta))
+    if (is_real(column)) reals_[column].resize(n_records);
+    else codes_[column].resize(n_records);
+  }
+  classes_.resize(n_records);
+  indices_.resize(n_records);
+  parallel_for(n_chunks, num_threads, [&](int idx)
+  {
+    const Chunk& chunk = chunks[idx];
+    int n_rows = chunk.codes.back().size();
+    for (int column = 0; column <= y_column; ++column)
     {
-      std::set<std::string> domain_set;
-      for (const Instance& instance : database_)
+      if (column < y_column and is_real(column))
       {
-        const Attribute::Ptr& attr = column < xmeta_.size()? instance.get_x()[column] :
-                                                             instance.get_y();
-        auto nattr = std::dynamic_pointer_cast<NominalAttribute>(attr);
-        if (nattr) domain_set.insert(nattr->get_category());
+        std::copy(chunk.reals[column].begin(), chunk.reals[column].end(),
+                  reals_[column].begin() + chunk.first_row);
+        continue;
       }
-      nmeta->set_domain(domain_set);
-    }
-    else if (auto rmeta = std::dynamic_pointer_cast<RealAttributeMeta>(meta))
-    {
-      double lo = std::numeric_limits<double>::infinity();
-      double up = -lo;
-      for (const Instance& instance : database_)
+      uint32_t* codes = column < y_column? &codes_[column][chunk.first_row] :
+                                           &classes_[chunk.first_row];
+      const std::vector<uint32_t>& translation = translations[idx][column];
+      for (int row = 0; row < n_rows; ++row)
       {
-        const Attribute::Ptr& attr = column < xmeta_.size()? instance.get_x()[column] :
-                                                             instance.get_y();
-        auto rattr = std::dynamic_pointer_cast<RealAttribute>(attr);
-        if (rattr)
-        {
-          double number = rattr->get_number();
-          if (number < lo) lo = number;
-          if (number > up) up = number;
-        }
+        uint32_t code = chunk.codes[column][row];
+        codes[row] = code == NominalAttributeMeta::MISSING? code : translation[code];
       }
-      rmeta->set_lower_bound(lo);
-      rmeta->set_upper_bound(up);
     }
-  }
+    for (int row = 0; row < n_rows; ++row) indices_[chunk.first_row + row] = chunk.first_row + row;
+  });
+  reset_instances();
 }
 
-void Dataframe::filter(int column, const std::string& category, std::set<int>& instances) const
+void Dataframe::fill_bounds()
 {
-  instances.clear();
-  int nx_columns = get_number_of_x_attributes();
-  for (int idx = 0; idx < database_.size(); ++idx)
+  for (int column = 0; column < xmeta_.size(); ++column)
   {
-    const Attribute::Ptr& attribute = column < nx_columns?
-      database_[idx].get_x()[column] : database_[idx].get_y();
-    if (auto nattr = std::dynamic_pointer_cast<NominalAttribute>(attribute))
+    if (not is_real(column)) continue;
+    auto rmeta = std::static_pointer_cast<RealAttributeMeta>(xmeta_[column]);
+    double lo = std::numeric_limits<double>::infinity();
+    double up = -lo;
+    for (double number : reals_[column])
     {
-      if (nattr->get_category() == category) instances.insert(idx);
+      if (number < lo) lo = number;
+      if (number > up) up = number;
     }
+    rmeta->set_lower_bound(lo);
+    rmeta->set_upper_bound(up);
   }
 }
 
-void Dataframe::init_godel()
+void Dataframe::reset_instances(bool build_coverage)
 {
-  for (const auto& meta : xmeta_)
+  instances_.clear();
+  instances_.reserve(classes_.size());
+  for (int row = 0; row < classes_.size(); ++row)
   {
-    if (auto nmeta = std::dynamic_pointer_cast<NominalAttributeMeta>(meta))
+    instances_.push_back(Instance(this, row));
+  }
+  if (build_coverage) coverage_.build(*schema_, reals_, codes_, classes_);
+}
+
+void Dataframe::gather(const Dataframe& source, const std::vector<int>& rows)
+{
+  std::vector<std::vector<double>> reals(source.reals_.size());
+  std::vector<std::vector<uint32_t>> codes(source.codes_.size());
+  std::vector<uint32_t> classes(rows.size());
+  std::vector<int> indices(rows.size());
+  for (int column = 0; column < source.reals_.size(); ++column)
+  {
+    if (source.is_real(column))
     {
-      std::map<CategoryPair, double> lu;
-      for (const std::string& v1 : nmeta->get_domain())
+      reals[column].resize(rows.size());
+      for (int idx = 0; idx < rows.size(); ++idx)
       {
-        for (const std::string& v2 : nmeta->get_domain())
-        {
-          lu[std::make_pair(v1, v2)] = v1 == v2? 0 : 1;
-        }
+        reals[column][idx] = source.reals_[column][rows[idx]];
       }
-      nmeta->set_lookup(lu);
+    }
+    else
+    {
+      codes[column].resize(rows.size());
+      for (int idx = 0; idx < rows.size(); ++idx)
+      {
+        codes[column][idx] = source.codes_[column][rows[idx]];
+      }
+    }
+  }
+  for (int idx = 0; idx < rows.size(); ++idx)
+  {
+    classes[idx] = source.classes_[rows[idx]];
+    indices[idx] = source.indices_[rows[idx]];
+  }
+  /* deriving the coverage index from the one of the source saves sorting the
+   * real columns again (it is built before swapping, since source may be this
+   * dataframe, e.g. when shuffling) */
+  CoverageIndex coverage;
+  coverage.build(*schema_, source.coverage_, rows, reals, codes, classes);
+  reals_.swap(reals);
+  codes_.swap(codes);
+  classes_.swap(classes);
+  indices_.swap(indices);
+  coverage_ = std::move(coverage);
+  reset_instances(false);
+}
+
+void Dataframe::init_godel(int column)
+{
+  auto nmeta = std::static_pointer_cast<NominalAttributeMeta>(xmeta_[column]);
+  uint32_t n_values = nmeta->get_domain_size();
+  std::vector<double> lu(n_values*n_values);
+  for (uint32_t v1 = 0; v1 < n_values; ++v1)
+  {
+    for (uint32_t v2 = 0; v2 < n_values; ++v2)
+    {
+      lu[v1*n_values + v2] = v1 == v2? 0 : 1;
     }
   }
+  nmeta->set_lookup(lu);
 }
 
-void Dataframe::init_svdm(double q)
+void Dataframe::init_svdm(int column, double q)
 {
-  for (int idx = 0; idx < xmeta_.size(); ++idx)
+  auto nmeta = std::static_pointer_cast<NominalAttributeMeta>(xmeta_[column]);
+  const uint32_t n_classes = schema_->ymeta->get_domain_size();
+  uint32_t n_values = nmeta->get_domain_size();
+  std::vector<double> lu(n_values*n_values);
+  std::vector<double> probs;
+  conditional_probs(column, probs);
+  for (uint32_t v1 = 0; v1 < n_values; ++v1)
   {
-    if (auto nmeta = std::dynamic_pointer_cast<NominalAttributeMeta>(xmeta_[idx]))
+    const double* p1 = probs.data() + v1*n_classes;
+    for (uint32_t v2 = 0; v2 < n_values; ++v2)
     {
-      auto cmeta = std::dynamic_pointer_cast<NominalAttributeMeta>(ymeta_);
-      std::map<CategoryPair, double> lu;
-      std::map<CategoryPair, double> cp;
-      conditional_probs(idx, cp);
-      for (const std::string& v1 : nmeta->get_domain())
-      {
-        for (const std::string& v2 : nmeta->get_domain())
-        {
-          auto v = std::make_pair(v1, v2);
-          for (const std::string& c : cmeta->get_domain())
-          {
-            auto p1 = std::make_pair(v1,c);
-            auto p2 = std::make_pair(v2,c);
-            lu[v] += std::pow(std::fabs(cp[p1]-cp[p2]), q);
-          }
-          lu[v] /= cmeta->get_domain().size();
-        }
-      }
-      nmeta->set_lookup(lu);
+      const double* p2 = probs.data() + v2*n_classes;
+      double d = 0;
+      for (uint32_t c = 0; c < n_classes; ++c) d += std::pow(std::fabs(p1[c]-p2[c]), q);
+      lu[v1*n_values + v2] = d/n_classes;
     }
   }
+  nmeta->set_lookup(lu);
 }
 
-void Dataframe::init_kl()
+void Dataframe::init_kl(int column)
 {
-  for (int idx = 0; idx < xmeta_.size(); ++idx)
+  auto nmeta = std::static_pointer_cast<NominalAttributeMeta>(xmeta_[column]);
+  const uint32_t n_classes = schema_->ymeta->get_domain_size();
+  uint32_t n_values = nmeta->get_domain_size();
+  std::vector<double> lu(n_values*n_values);
+  std::vector<double> probs;
+  conditional_probs(column, probs);
+  for (uint32_t v1 = 0; v1 < n_values; ++v1)
   {
-    if (auto nmeta = std::dynamic_pointer_cast<NominalAttributeMeta>(xmeta_[idx]))
+    const double* p1 = probs.data() + v1*n_classes;
+    for (uint32_t v2 = 0; v2 < n_values; ++v2)
     {
-      auto cmeta = std::dynamic_pointer_cast<NominalAttributeMeta>(ymeta_);
-      std::map<CategoryPair, double> lu;
-      std::map<CategoryPair, double> cp;
-      conditional_probs(idx, cp);
-      for (const std::string& v1 : nmeta->get_domain())
+      const double* p2 = probs.data() + v2*n_classes;
+      double d = 0;
+      for (uint32_t c = 0; c < n_classes; ++c)
       {
-        for (const std::string& v2 : nmeta->get_domain())
+        // comparisons with NaN (categories without instances) are false
+        if (p1[c] > 0)
         {
-          auto v = std::make_pair(v1, v2);
-          for (const std::string& c : cmeta->get_domain())
+          if (p2[c] > 0) d -= p1[c]*std::log2(p2[c]/p1[c]);
+          else
           {
-            auto p1 = std::make_pair(v1,c);
-            auto p2 = std::make_pair(v2,c);
-            if (cp[p1] > 0)
-            {
-              if (cp[p2] > 0) lu[v] -= cp[p1]*std::log2(cp[p2]/cp[p1]);
-              else 
-              {
-                lu[v] = std::numeric_limits<double>::infinity();
-                break;
-              }
-            }
+            d = std::numeric_limits<double>::infinity();
+            break;
           }
-          lu[v] = (1 - std::exp(-lu[v]))/(1 + std::exp(-lu[v]));
         }
       }
-      nmeta->set_lookup(lu);
+      lu[v1*n_values + v2] = (1 - std::exp(-d))/(1 + std::exp(-d));
     }
   }
+  nmeta->set_lookup(lu);
 }
 
 } /* end namespace rise */
+
@@ -2,14 +2,51 @@
 #define DATAFRAME_H
 
 #include "common.h"
+#include "coverage.h"
 #include "csv_reader.h"
 
+#include <cmath>
 #include <set>
 
 namespace rise
 {
 
 class Dataframe;
+class Instance;
+
+/*
+ * Lightweight handle to a row of a Dataframe. It does not own any data: the
+ * attribute values are read from the (columnar) storage of the dataframe.
+ */
+class Instance : public Stringifiable
+{
+  public:
+
+    Instance(const Dataframe* df, int row) : df_(df), row_(row) {}
+
+    const Dataframe& get_dataframe() const { return *df_; }
+
+    int get_row() const { return row_; }
+
+    int get_index() const;
+
+    double get_real(int column) const;
+
+    uint32_t get_code(int column) const;
+
+    bool is_missing(int column) const;
+
+    uint32_t get_class_code() const;
+
+    const std::string& get_class() const;
+
+    virtual std::string to_str() const override;
+
+  private:
+
+    const Dataframe* df_;
+    int row_;
+};
 
 class Dataframe : public Stringifiable
 {
@@ -19,58 +56,154 @@ class Dataframe : public Stringifiable
 
     Dataframe();
 
-    Dataframe(const std::string& datafile, const std::string& metafile, char delim=',');
+    /*
+     * The data file is parsed with up to num_threads threads (non-positive
+     * values select as many threads as hardware threads are available).
+     */
+    Dataframe(const std::string& datafile, const std::string& metafile, char delim=',',
+              int num_threads=1);
+
+    /*
+     * Data file encoded with the (shared) metadata of schema, e.g. the one of a
+     * trained classifier, which is not modified: categories out of its domains
+     * are taken as missing values. The metafile must define the same attributes.
+     */
+    Dataframe(const std::string& datafile, const std::string& metafile,
+              const Schema::Ptr& schema, char delim=',', int num_threads=1);
 
     Dataframe(const Dataframe& other) = delete;
 
     Dataframe& operator=(const Dataframe& other) = delete;
 
-    void init_lu(NDistance type, double q=1.0);
+    /*
+     * Builds the lookup table of every nominal attribute, with up to
+     * num_threads threads (non-positive values select as many threads as
+     * hardware threads are available).
+     */
+    void init_lu(NDistance type, double q=1.0, int num_threads=1);
+
+    // seconds spent by init_lu on each nominal attribute (in Schema order)
+    const std::vector<double>& get_lu_times() const { return lu_times_; }
 
     const std::vector<AttributeMeta::Ptr>& get_xmeta() const { return xmeta_; }
 
     const AttributeMeta::Ptr& get_ymeta() const { return ymeta_; }
 
-    const std::vector<Instance>& get_instances() const { return database_; }
+    const Schema::Ptr& get_schema() const { return schema_; }
+
+    const std::vector<Instance>& get_instances() const { return instances_; }
 
-    int get_number_of_records() const { return database_.size(); }
+    int get_number_of_records() const { return instances_.size(); }
 
     int get_number_of_x_attributes() const { return xmeta_.size(); }
 
     int get_number_of_missing_values() const;
 
+    bool is_real(int column) const { return schema_->is_real[column]; }
+
+    // Real values are NaN when missing
+    double get_real(int row, int column) const { return reals_[column][row]; }
+
+    // Nominal values are NominalAttributeMeta::MISSING when missing
+    uint32_t get_code(int row, int column) const { return codes_[column][row]; }
+
+    uint32_t get_class_code(int row) const { return classes_[row]; }
+
+    int get_index(int row) const { return indices_[row]; }
+
+    const std::vector<double>& get_real_column(int column) const { return reals_[column]; }
+
+    const std::vector<uint32_t>& get_nominal_column(int column) const { return codes_[column]; }
+
+    const std::vector<uint32_t>& get_class_column() const { return classes_; }
+
+    const CoverageIndex& get_coverage_index() const { return coverage_; }
+
     void shuffle();
 
-    void conditional_probs(int column, std::map<CategoryPair, double>& results) const;
+    /*
+     * P(class|category) for every category of a nominal column, stored as
+     * probs[code*n_classes + class_code] (NaN for categories without instances).
+     */
+    void conditional_probs(int column, std::vector<double>& probs) const;
 
+    /*
+     * Both train and val get their own copy of the metadata (shared between
+     * them), so calling init_lu on different folds is safe (even concurrently).
+     */
     void split(int fold_idx, int k, Dataframe& train, Dataframe& val) const;
 
+    // same, with the given rows in train and val (e.g. the ones of a Fold)
+    void split(const std::vector<int>& train_rows, const std::vector<int>& val_rows,
+               Dataframe& train, Dataframe& val) const;
+
+    /*
+     * Binary snapshot of the dataframe (data, domains, bounds and lookup
+     * tables), so it can be loaded without parsing and preprocessing again.
+     * load replaces the contents of the dataframe.
+     */
+    void save(const std::string& filename) const;
+
+    void load(const std::string& filename);
+
     virtual std::string to_str() const override;
 
   private:
 
     int read_metadata(const std::string& metafile);
 
-    void fill_database(const std::vector<CsvRow>& raw_data);
+    void clone_metadata(const Dataframe& source);
+
+    // fills the domains of the nominal attributes unless fixed_domains
+    void read_database(const MappedFile& file, char delim, int target_column, int num_threads,
+                       bool fixed_domains=false);
 
-    void fill_domains();
+    void fill_bounds();
 
-    void filter(int column, const std::string& category, std::set<int>& instances) const;
+    // rebuilds instances_ (and coverage_ if build_coverage) from the columns
+    void reset_instances(bool build_coverage=true);
 
-    void init_godel();
+    void gather(const Dataframe& source, const std::vector<int>& rows);
 
-    void init_svdm(double q);
+    // lookup table of a nominal column
+    void init_godel(int column);
+
+    void init_svdm(int column, double q);
+
+    void init_kl(int column);
 
-    void init_kl();
-    
     std::vector<AttributeMeta::Ptr> xmeta_;
     AttributeMeta::Ptr ymeta_;
-    std::vector<Instance> database_;
+    Schema::Ptr schema_;
+
+    /* column-major storage (only one of reals_[i] and codes_[i] is used) */
+    std::vector<std::vector<double>> reals_;
+    std::vector<std::vector<uint32_t>> codes_;
+    std::vector<uint32_t> classes_;
+    std::vector<int> indices_;
+    std::vector<Instance> instances_;
+    CoverageIndex coverage_;
+    std::vector<double> lu_times_;
 
 };
 
+// Instance's inline methods
+
+inline int Instance::get_index() const { return df_->get_index(row_); }
+
+inline double Instance::get_real(int column) const { return df_->get_real(row_, column); }
+
+inline uint32_t Instance::get_code(int column) const { return df_->get_code(row_, column); }
+
+inline bool Instance::is_missing(int column) const
+{
+  return df_->is_real(column)? std::isnan(get_real(column)) :
+                               get_code(column) == NominalAttributeMeta::MISSING;
+}
+
+inline uint32_t Instance::get_class_code() const { return df_->get_class_code(row_); }
+
 } /* end namespace rise */
 
 #endif
 
-
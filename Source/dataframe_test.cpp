@@ -1,4 +1,5 @@
 #include "dataframe.h"
+#include <cstdio>
 #include <cstdlib>
 #include <iostream>
 
@@ -15,8 +16,52 @@ int main(int argc, char* argv[])
     std::string datafile = std::string("../Data/") + argv[1] + '/' + argv[1] + ".data";
     std::string metafile = std::string("../Data/") + argv[1] + '/' + argv[1] + ".meta";
     rise::Dataframe df(datafile, metafile);
+    auto count_differences = [](const rise::Dataframe& df1, const rise::Dataframe& df2)
+    {
+      int differences = df1.get_number_of_records() != df2.get_number_of_records();
+      for (int column = 0; column < df1.get_number_of_x_attributes() and not differences; ++column)
+      {
+        if (df1.is_real(column))
+        {
+          for (int row = 0; row < df1.get_number_of_records(); ++row)
+          {
+            double x1 = df1.get_real(row, column), x2 = df2.get_real(row, column);
+            if (x1 != x2 and not (std::isnan(x1) and std::isnan(x2))) ++differences;
+          }
+        }
+        else
+        {
+          auto nmeta1 = std::static_pointer_cast<rise::NominalAttributeMeta>(df1.get_xmeta()[column]);
+          auto nmeta2 = std::static_pointer_cast<rise::NominalAttributeMeta>(df2.get_xmeta()[column]);
+          differences += nmeta1->get_domain() != nmeta2->get_domain();
+          differences += nmeta1->get_lookup() != nmeta2->get_lookup();
+          differences += df1.get_nominal_column(column) != df2.get_nominal_column(column);
+        }
+      }
+      differences += df1.get_class_column() != df2.get_class_column();
+      for (int row = 0; row < df1.get_number_of_records() and not differences; ++row)
+      {
+        differences += df1.get_index(row) != df2.get_index(row);
+      }
+      return differences;
+    };
+    /* loading with several threads must yield the same dataframe */
+    rise::Dataframe df4(datafile, metafile, ',', 4);
+    std::cout << "#Differences loading with 4 threads: " << count_differences(df, df4) << std::endl;
+    /* so must building the lookup tables with several threads */
+    df.init_lu(rise::Dataframe::KL);
+    df4.init_lu(rise::Dataframe::KL, 1.0, 4);
+    std::cout << "#Differences building lookup tables with 4 threads: "
+              << count_differences(df, df4) << std::endl;
     df.shuffle();
     df.init_lu(rise::Dataframe::KL);
+    /* a snapshot must restore the same (shuffled and preprocessed) dataframe */
+    std::string snapshot = std::string("/tmp/") + argv[1] + ".snapshot";
+    df.save(snapshot);
+    rise::Dataframe loaded;
+    loaded.load(snapshot);
+    std::remove(snapshot.c_str());
+    std::cout << "#Differences loading a snapshot: " << count_differences(df, loaded) << std::endl;
     std::cout << df << std::endl;
     //rise::Dataframe train, val;
     //for (int fold_idx = 0; fold_idx < 10; ++fold_idx)
@@ -25,13 +70,9 @@ int main(int argc, char* argv[])
       //df.split(fold_idx, 10, train, val);
       //std::cout << train << std::endl << val << std::endl;
     //}
-    //std::map<rise::CategoryPair, double> cp;
-    //df.conditional_probs(1, cp);
-    //for (const auto& entry : cp)
-    //{
-      //std::cout << "P(" << entry.first.second << '|' << entry.first.first <<
-        //") = " << entry.second << std::endl;
-    //}
+    //std::vector<double> probs;
+    //df.conditional_probs(1, probs);
+    //for (double p : probs) std::cout << p << std::endl;
   }
   catch (rise::RiseException& ex)
   {
@@ -0,0 +1,194 @@
+#include "evaluation.h"
+#include "parallel.h"
+#include <chrono>
+#include <cmath>
+#include <random>
+
+namespace rise
+{
+
+namespace /* utils for internal usage */
+{
+
+double elapsed_since(const std::chrono::steady_clock::time_point& start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::mt19937_64 make_generator(uint64_t seed, int repetition)
+{
+  std::seed_seq seq{uint32_t(seed), uint32_t(seed >> 32), uint32_t(repetition)};
+  return std::mt19937_64(seq);
+}
+
+// uniform in [0, n), rejecting the values that would make rng() % n biased
+uint64_t uniform_below(std::mt19937_64& rng, uint64_t n)
+{
+  uint64_t threshold = -n % n; // 2^64 mod n
+  uint64_t value;
+  do value = rng(); while (value < threshold);
+  return value % n;
+}
+
+/*
+ * Rows grouped by class (rows of missing class last), each group in random
+ * order: first index and end of each group in groups.
+ */
+std::vector<int> permute_by_class(const Dataframe& df, std::mt19937_64& rng,
+    std::vector<std::pair<int,int>>& groups)
+{
+  uint32_t n_classes = df.get_schema()->ymeta->get_domain_size();
+  std::vector<std::vector<int>> rows(n_classes + 1);
+  for (int row = 0; row < df.get_number_of_records(); ++row)
+  {
+    uint32_t code = df.get_class_code(row);
+    rows[code == NominalAttributeMeta::MISSING? n_classes : code].push_back(row);
+  }
+  std::vector<int> order;
+  order.reserve(df.get_number_of_records());
+  groups.clear();
+  for (std::vector<int>& group : rows)
+  {
+    for (int idx = group.size() - 1; idx > 0; --idx)
+    {
+      std::swap(group[idx], group[uniform_below(rng, idx + 1)]);
+    }
+    groups.push_back(std::make_pair(order.size(), order.size() + group.size()));
+    order.insert(order.end(), group.begin(), group.end());
+  }
+  return order;
+}
+
+// rows in increasing order, each one to the validation rows of its fold
+std::vector<Fold> make_folds(const std::vector<int>& fold_of, int k)
+{
+  std::vector<Fold> folds(k);
+  for (int row = 0; row < fold_of.size(); ++row)
+  {
+    for (int fold = 0; fold < k; ++fold)
+    {
+      if (fold_of[row] == fold) folds[fold].val_rows.push_back(row);
+      else folds[fold].train_rows.push_back(row);
+    }
+  }
+  return folds;
+}
+
+void check_folds(const Dataframe& df, int k)
+{
+  if (k < 2 or k > df.get_number_of_records())
+  {
+    throw RiseException("Wrong number of folds: " + std::to_string(k));
+  }
+}
+
+} /* end anonymous namespace */
+
+// Free methods' implementation
+
+std::vector<Fold> kfold(const Dataframe& df, int k)
+{
+  check_folds(df, k);
+  int n_records = df.get_number_of_records();
+  std::vector<int> fold_of(n_records, k-1);
+  for (int row = 0; row < (k-1)*(n_records/k); ++row) fold_of[row] = row/(n_records/k);
+  return make_folds(fold_of, k);
+}
+
+std::vector<Fold> stratified_kfold(const Dataframe& df, int k, uint64_t seed, int repetition)
+{
+  /* dealing the rows of each class in turn (without restarting at the first
+   * fold for every class) also balances the sizes of the folds */
+  check_folds(df, k);
+  std::mt19937_64 rng = make_generator(seed, repetition);
+  std::vector<std::pair<int,int>> groups;
+  std::vector<int> order = permute_by_class(df, rng, groups);
+  std::vector<int> fold_of(order.size());
+  for (int idx = 0; idx < order.size(); ++idx) fold_of[order[idx]] = idx%k;
+  return make_folds(fold_of, k);
+}
+
+std::vector<Fold> repeated_stratified_kfold(const Dataframe& df, int k, int repetitions,
+    uint64_t seed)
+{
+  std::vector<Fold> folds;
+  for (int repetition = 0; repetition < repetitions; ++repetition)
+  {
+    std::vector<Fold> repetition_folds = stratified_kfold(df, k, seed, repetition);
+    folds.insert(folds.end(), repetition_folds.begin(), repetition_folds.end());
+  }
+  return folds;
+}
+
+std::vector<Fold> stratified_holdout(const Dataframe& df, double fraction, int repetitions,
+    uint64_t seed)
+{
+  if (not (fraction > 0 and fraction < 1))
+  {
+    throw RiseException("Wrong fraction of validation rows: " + std::to_string(fraction));
+  }
+  std::vector<Fold> folds;
+  for (int repetition = 0; repetition < repetitions; ++repetition)
+  {
+    std::mt19937_64 rng = make_generator(seed, repetition);
+    std::vector<std::pair<int,int>> groups;
+    std::vector<int> order = permute_by_class(df, rng, groups);
+    std::vector<int> fold_of(order.size(), 1);
+    for (const auto& group : groups)
+    {
+      int n_val = std::lround(fraction*(group.second - group.first));
+      for (int idx = group.first; idx < group.first + n_val; ++idx) fold_of[order[idx]] = 0;
+    }
+    // the second fold (validating with the rest of the rows) is dropped
+    Fold fold = make_folds(fold_of, 2)[0];
+    if (fold.train_rows.empty() or fold.val_rows.empty())
+    {
+      throw RiseException("Empty training or validation rows in hold-out");
+    }
+    folds.push_back(fold);
+  }
+  return folds;
+}
+
+std::vector<FoldResult> evaluate(const Dataframe& df, const std::vector<Fold>& folds,
+    Dataframe::NDistance dtype, double q, int parallel_folds, int num_threads)
+{
+  /* every fold has its own split, lookup tables and classifier */
+  std::vector<FoldResult> results(folds.size());
+  parallel_for(folds.size(), parallel_folds, [&](int idx)
+  {
+    FoldResult& result = results[idx];
+    auto start = std::chrono::steady_clock::now();
+    Dataframe train, val;
+    df.split(folds[idx].train_rows, folds[idx].val_rows, train, val);
+    result.split_time = elapsed_since(start);
+    start = std::chrono::steady_clock::now();
+    train.init_lu(dtype, q, num_threads);
+    result.lu_time = elapsed_since(start);
+    RiseClassifier classifier(false, num_threads);
+    classifier.train(train);
+    result.train_time = classifier.get_train_time();
+    result.n_rules = classifier.get_number_of_rules();
+    start = std::chrono::steady_clock::now();
+    result.accuracy = classifier.test(val);
+    result.test_time = elapsed_since(start);
+  });
+  return results;
+}
+
+void mean_stdev(const std::vector<double>& values, double& mean, double& stdev)
+{
+  double mean_sq = 0;
+  mean = 0;
+  for (double value : values)
+  {
+    mean += value;
+    mean_sq += value*value;
+  }
+  mean /= values.size();
+  mean_sq /= values.size();
+  stdev = std::sqrt(mean_sq - mean*mean);
+}
+
+} /* end namespace rise */
+
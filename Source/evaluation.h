@@ -0,0 +1,70 @@
+#ifndef EVALUATION_H
+#define EVALUATION_H
+
+#include "algorithm.h"
+#include "dataframe.h"
+
+namespace rise
+{
+
+/*
+ * Rows of a dataframe on which a classifier is trained and validated (both in
+ * increasing order, so training does not depend on how the folds were drawn).
+ */
+struct Fold
+{
+  std::vector<int> train_rows, val_rows;
+};
+
+/*
+ * Generators of folds. The randomized ones draw a permutation of the rows of
+ * each class from a std::mt19937_64 seeded with (seed, repetition), so every
+ * repetition has its own generator and the folds do not depend on the global
+ * state of rand(). Permutations are drawn with an unbiased Fisher-Yates
+ * shuffle.
+ */
+
+// the k consecutive blocks of Dataframe::split (the last one takes the rest)
+std::vector<Fold> kfold(const Dataframe& df, int k);
+
+/*
+ * k folds where each class is spread as evenly as possible: the number of
+ * instances of any class in two validation sets differs by one at most.
+ */
+std::vector<Fold> stratified_kfold(const Dataframe& df, int k, uint64_t seed,
+    int repetition=0);
+
+// the folds of each repetition one after another
+std::vector<Fold> repeated_stratified_kfold(const Dataframe& df, int k, int repetitions,
+    uint64_t seed);
+
+// one fold per repetition, validating with (rounded) fraction of every class
+std::vector<Fold> stratified_holdout(const Dataframe& df, double fraction, int repetitions,
+    uint64_t seed);
+
+struct FoldResult
+{
+  double accuracy;
+  int n_rules;
+  // seconds spent splitting the data, building the lookup tables, training
+  // (as given by RiseClassifier::get_train_time) and testing
+  double split_time, lu_time, train_time, test_time;
+};
+
+/*
+ * Trains a classifier on the training rows of every fold (with the lookup
+ * tables built from them) and tests it on the validation rows. Up to
+ * parallel_folds folds are run concurrently, each one with num_threads
+ * threads; results are given in the order of folds and do not depend on
+ * either number.
+ */
+std::vector<FoldResult> evaluate(const Dataframe& df, const std::vector<Fold>& folds,
+    Dataframe::NDistance dtype, double q, int parallel_folds=1, int num_threads=1);
+
+// population standard deviation
+void mean_stdev(const std::vector<double>& values, double& mean, double& stdev);
+
+} /* end namespace rise */
+
+#endif
+
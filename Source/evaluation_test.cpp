@@ -0,0 +1,91 @@
+#include "evaluation.h"
+#include <algorithm>
+#include <iostream>
+
+/* Checks that folds are partitions of the rows and that stratified folds keep
+ * the proportion of each class, and evaluates a few folds */
+int main(int argc, char* argv[])
+{
+  if (argc != 2)
+  {
+    std::cerr << "Usage: evaluation_test datasetname\n";
+    return -1;
+  }
+  try
+  {
+    std::string datafile = std::string("../Data/") + argv[1] + '/' + argv[1] + ".data";
+    std::string metafile = std::string("../Data/") + argv[1] + '/' + argv[1] + ".meta";
+    rise::Dataframe df(datafile, metafile);
+    int n_classes = df.get_schema()->ymeta->get_domain_size();
+    /* every row must be validated once per repetition and trained on in the
+     * other folds of the repetition */
+    auto count_errors = [&](const std::vector<rise::Fold>& folds, int k)
+    {
+      int errors = 0;
+      for (int start = 0; start < folds.size(); start += k)
+      {
+        std::vector<int> validated(df.get_number_of_records(), 0);
+        for (int fold = start; fold < start + k; ++fold)
+        {
+          const rise::Fold& f = folds[fold];
+          errors += f.train_rows.size() + f.val_rows.size() != df.get_number_of_records();
+          errors += not std::is_sorted(f.train_rows.begin(), f.train_rows.end());
+          for (int row : f.val_rows) ++validated[row];
+        }
+        for (int times : validated) errors += times != 1;
+      }
+      return errors;
+    };
+    // max over classes of the difference between the largest and smallest count in a fold
+    auto class_imbalance = [&](const std::vector<rise::Fold>& folds)
+    {
+      int imbalance = 0;
+      for (int code = 0; code < n_classes; ++code)
+      {
+        int min_count = df.get_number_of_records(), max_count = 0;
+        for (const rise::Fold& fold : folds)
+        {
+          int count = 0;
+          for (int row : fold.val_rows) count += df.get_class_code(row) == code;
+          min_count = std::min(min_count, count);
+          max_count = std::max(max_count, count);
+        }
+        imbalance = std::max(imbalance, max_count - min_count);
+      }
+      return imbalance;
+    };
+    auto kfolds = rise::kfold(df, 10);
+    auto stratified = rise::repeated_stratified_kfold(df, 10, 3, 42);
+    std::cout << "#Errors in consecutive folds: " << count_errors(kfolds, 10) << std::endl;
+    std::cout << "#Errors in stratified folds: " << count_errors(stratified, 10) << std::endl;
+    std::cout << "Class imbalance of stratified folds: "
+              << class_imbalance(std::vector<rise::Fold>(stratified.begin(), stratified.begin() + 10))
+              << " (at most 1)" << std::endl;
+    std::cout << "Same folds with the same seed: "
+              << (rise::stratified_kfold(df, 10, 42, 2).front().val_rows == stratified[20].val_rows)
+              << std::endl;
+    std::cout << "Same folds with another seed: "
+              << (rise::stratified_kfold(df, 10, 43).front().val_rows == stratified[0].val_rows)
+              << std::endl;
+    auto holdout = rise::stratified_holdout(df, 0.3, 2, 42);
+    std::cout << "Hold-out sizes: " << holdout[0].train_rows.size() << '/'
+              << holdout[0].val_rows.size() << std::endl;
+    /* the results must not depend on the number of folds run concurrently */
+    auto folds = std::vector<rise::Fold>(stratified.begin(), stratified.begin() + 4);
+    auto results1 = rise::evaluate(df, folds, rise::Dataframe::SVDM, 1.0, 1);
+    auto results4 = rise::evaluate(df, folds, rise::Dataframe::SVDM, 1.0, 4);
+    int differences = 0;
+    for (int fold = 0; fold < folds.size(); ++fold)
+    {
+      differences += results1[fold].accuracy != results4[fold].accuracy or
+                     results1[fold].n_rules != results4[fold].n_rules;
+      std::cout << "Fold " << fold << ": accuracy " << 100*results1[fold].accuracy << "%, "
+                << results1[fold].n_rules << " rules" << std::endl;
+    }
+    std::cout << "#Differences evaluating 4 folds concurrently: " << differences << std::endl;
+  }
+  catch (rise::RiseException& ex)
+  {
+    std::cerr << ex.what() << '\n';
+  }
+}
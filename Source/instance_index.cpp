@@ -0,0 +1,258 @@
+#include "instance_index.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace rise
+{
+
+namespace /* utils for internal usage */
+{
+
+// the lower bounds are not computed exactly as the distances, so a bit of
+// slack avoids pruning instances at the same distance as the nearest one
+const double PRUNE_SLACK = 2e-9;
+
+} /* end anonymous namespace */
+
+const int InstanceIndex::LEAF_SIZE = 16;
+
+void InstanceIndex::build(const Dataframe& df)
+{
+  clear();
+  df_ = &df;
+  const Schema& schema = *df.get_schema();
+  int offset = 0;
+  for (const auto& meta : schema.nominal_meta)
+  {
+    offsets_.push_back(offset);
+    offset += meta->get_domain_size();
+  }
+  /* rows are grouped by class (keeping their order within each class) */
+  int n_classes = schema.ymeta->get_domain_size();
+  std::vector<int> class_begin(n_classes + 1, 0);
+  for (int row = 0; row < df.get_number_of_records(); ++row)
+  {
+    uint32_t code = df.get_class_code(row);
+    if (code != NominalAttributeMeta::MISSING) ++class_begin[code+1];
+  }
+  for (int code = 0; code < n_classes; ++code) class_begin[code+1] += class_begin[code];
+  order_.resize(class_begin.back());
+  std::vector<int> next(class_begin.begin(), class_begin.end() - 1);
+  for (int row = 0; row < df.get_number_of_records(); ++row)
+  {
+    uint32_t code = df.get_class_code(row);
+    if (code != NominalAttributeMeta::MISSING) order_[next[code]++] = row;
+  }
+  nodes_.reserve(2*(order_.size()/LEAF_SIZE + n_classes));
+  roots_.assign(n_classes, -1);
+  for (int code = 0; code < n_classes; ++code)
+  {
+    if (class_begin[code] < class_begin[code+1])
+    {
+      roots_[code] = build_node(class_begin[code], class_begin[code+1]);
+    }
+  }
+}
+
+void InstanceIndex::clear()
+{
+  df_ = nullptr;
+  order_.clear();
+  roots_.clear();
+  offsets_.clear();
+  nodes_.clear();
+}
+
+const Instance* InstanceIndex::nearest(const Rule& rule, double& min_dist) const
+{
+  Nearest nearest;
+  nearest.row = -1;
+  nearest.dist = std::numeric_limits<double>::infinity();
+  uint32_t code = rule.get_consequent_code();
+  if (df_ and code < roots_.size() and roots_[code] >= 0) search(roots_[code], rule, nearest);
+  min_dist = nearest.dist;
+  return nearest.row < 0? nullptr : &df_->get_instances()[nearest.row];
+}
+
+int InstanceIndex::build_node(int begin, int end)
+{
+  const Schema& schema = *df_->get_schema();
+  int n_real = schema.real_columns.size();
+  int n_nominal = schema.nominal_columns.size();
+  int node_idx = nodes_.size();
+  nodes_.push_back(Node());
+  Node node;
+  node.begin = begin;
+  node.end = end;
+  node.left = node.right = -1;
+  node.hull.resize(2*n_real);
+  node.real_missing.assign(n_real, false);
+  for (int k = 0; k < n_real; ++k)
+  {
+    node.hull[2*k] = std::numeric_limits<double>::infinity();
+    node.hull[2*k+1] = -std::numeric_limits<double>::infinity();
+    const std::vector<double>& reals = df_->get_real_column(schema.real_columns[k]);
+    for (int idx = begin; idx < end; ++idx)
+    {
+      double number = reals[order_[idx]];
+      if (std::isnan(number)) node.real_missing[k] = true;
+      else
+      {
+        node.hull[2*k] = std::min(node.hull[2*k], number);
+        node.hull[2*k+1] = std::max(node.hull[2*k+1], number);
+      }
+    }
+  }
+  /* NaN distances are skipped (instances at a NaN distance are never taken
+   * anyway), and attributes without a lookup table do not add to distances */
+  for (int k = 0; k < n_nominal; ++k)
+  {
+    const NominalAttributeMeta& meta = *schema.nominal_meta[k];
+    const std::vector<uint32_t>& codes = df_->get_nominal_column(schema.nominal_columns[k]);
+    std::vector<uint32_t> categories;
+    bool missing = meta.get_lookup().empty();
+    for (int idx = begin; idx < end; ++idx)
+    {
+      uint32_t code = codes[order_[idx]];
+      if (code == NominalAttributeMeta::MISSING) missing = true;
+      else categories.push_back(code);
+    }
+    std::sort(categories.begin(), categories.end());
+    categories.erase(std::unique(categories.begin(), categories.end()), categories.end());
+    node.min_distances.resize(offsets_[k] + meta.get_domain_size(),
+        missing? 0 : std::numeric_limits<double>::infinity());
+    if (missing) continue;
+    double* min_distances = node.min_distances.data() + offsets_[k];
+    for (uint32_t category = 0; category < meta.get_domain_size(); ++category)
+    {
+      for (uint32_t code : categories)
+      {
+        double d = meta.lookup_distance(category, code);
+        if (d < min_distances[category]) min_distances[category] = d;
+      }
+    }
+  }
+  if (end - begin > LEAF_SIZE)
+  {
+    /* ball-tree like split: take two distant instances as pivots and sort the
+     * instances by how much closer they are to the first pivot than to the
+     * second one */
+    auto first = order_.begin() + begin;
+    auto last = order_.begin() + end;
+    auto farthest = [&](int from)
+    {
+      int far = *first;
+      double max_dist = -1;
+      for (auto it = first; it != last; ++it)
+      {
+        double dist = dissimilarity(from, *it);
+        if (dist > max_dist)
+        {
+          max_dist = dist;
+          far = *it;
+        }
+      }
+      return far;
+    };
+    int pivot1 = farthest(*first);
+    int pivot2 = farthest(pivot1);
+    std::vector<std::pair<double,int>> keys;
+    keys.reserve(end - begin);
+    for (auto it = first; it != last; ++it)
+    {
+      double key = dissimilarity(pivot1, *it) - dissimilarity(pivot2, *it);
+      keys.push_back(std::make_pair(key, *it));
+    }
+    std::sort(keys.begin(), keys.end());
+    for (int idx = 0; idx < keys.size(); ++idx) order_[begin+idx] = keys[idx].second;
+    int middle = (begin + end)/2;
+    node.left = build_node(begin, middle);
+    node.right = build_node(middle, end);
+  }
+  nodes_[node_idx] = std::move(node);
+  return node_idx;
+}
+
+double InstanceIndex::dissimilarity(int row1, int row2) const
+{
+  /* missing values are close to anything */
+  const Schema& schema = *df_->get_schema();
+  double dist_total = 0;
+  for (int k = 0; k < schema.real_columns.size(); ++k)
+  {
+    const std::vector<double>& reals = df_->get_real_column(schema.real_columns[k]);
+    double d = std::fabs(reals[row1] - reals[row2])/schema.real_meta[k]->get_range();
+    if (d > 0) dist_total += d; // false for NaN
+  }
+  for (int k = 0; k < schema.nominal_columns.size(); ++k)
+  {
+    const NominalAttributeMeta& meta = *schema.nominal_meta[k];
+    const std::vector<uint32_t>& codes = df_->get_nominal_column(schema.nominal_columns[k]);
+    if (codes[row1] == NominalAttributeMeta::MISSING or
+        codes[row2] == NominalAttributeMeta::MISSING or meta.get_lookup().empty())
+    {
+      continue;
+    }
+    double d = meta.lookup_distance(codes[row1], codes[row2]);
+    if (d > 0) dist_total += d;
+  }
+  return dist_total;
+}
+
+double InstanceIndex::lower_bound(const Node& node, const Rule& rule) const
+{
+  /* the distance of a rule is the sum of the distances of each attribute
+   * divided by the number of attributes taken into account, which is never
+   * greater than the number of attributes */
+  const Schema& schema = *df_->get_schema();
+  const std::vector<double>& bounds = rule.get_bounds();
+  const std::vector<uint32_t>& categories = rule.get_categories();
+  double dist_total = 0;
+  for (int k = 0; k < schema.real_columns.size(); ++k)
+  {
+    if (node.real_missing[k] or std::isnan(bounds[2*k])) continue;
+    double lo = node.hull[2*k];
+    double up = node.hull[2*k+1];
+    if (up < bounds[2*k]) dist_total += (bounds[2*k] - up)/schema.real_meta[k]->get_range();
+    else if (lo > bounds[2*k+1]) dist_total += (lo - bounds[2*k+1])/schema.real_meta[k]->get_range();
+  }
+  for (int k = 0; k < schema.nominal_columns.size(); ++k)
+  {
+    if (categories[k] != Rule::DROPPED) dist_total += node.min_distances[offsets_[k]+categories[k]];
+  }
+  return dist_total/schema.xmeta.size();
+}
+
+void InstanceIndex::search(int node_idx, const Rule& rule, Nearest& nearest) const
+{
+  const Node& node = nodes_[node_idx];
+  if (node.left < 0)
+  {
+    for (int idx = node.begin; idx < node.end; ++idx)
+    {
+      int row = order_[idx];
+      // never abandons for instances as near as the nearest one
+      double dist = rule.distance(df_->get_instances()[row], nearest.dist);
+      if (dist > 1e-9 and (dist < nearest.dist or (dist == nearest.dist and row < nearest.row)))
+      {
+        nearest.row = row;
+        nearest.dist = dist;
+      }
+    }
+    return;
+  }
+  double left_bound = lower_bound(nodes_[node.left], rule);
+  double right_bound = lower_bound(nodes_[node.right], rule);
+  int first = node.left, second = node.right;
+  if (right_bound < left_bound)
+  {
+    std::swap(first, second);
+    std::swap(left_bound, right_bound);
+  }
+  if (not (left_bound > nearest.dist + PRUNE_SLACK)) search(first, rule, nearest);
+  if (not (right_bound > nearest.dist + PRUNE_SLACK)) search(second, rule, nearest);
+}
+
+} /* end namespace rise */
+
@@ -0,0 +1,78 @@
+#ifndef INSTANCE_INDEX_H
+#define INSTANCE_INDEX_H
+
+#include "dataframe.h"
+#include "rules.h"
+
+namespace rise
+{
+
+class InstanceIndex;
+
+/*
+ * Instances of a dataframe partitioned by class, with a tree over each
+ * partition that answers which is the nearest instance of the class of a rule
+ * that is not covered by it (i.e. at a distance greater than 1e-9) without
+ * computing the distance to every instance of the class. Each node keeps a
+ * summary of its instances (the hull of the values of each real attribute and
+ * the minimum distance from every category of each nominal attribute to their
+ * categories), from which a lower bound of the distance between a rule and any
+ * of its instances is derived. Subtrees whose bound cannot beat the nearest
+ * instance found so far are skipped.
+ *
+ * Among instances at the same distance, the one in the lowest row is taken,
+ * so queries return the same instance as a linear scan of the class.
+ */
+class InstanceIndex
+{
+  public:
+
+    InstanceIndex() : df_(nullptr) {}
+
+    void build(const Dataframe& df);
+
+    void clear();
+
+    // nullptr (and infinity) if the rule covers every instance of its class
+    const Instance* nearest(const Rule& rule, double& min_dist) const;
+
+  private:
+
+    struct Node
+    {
+      int begin, end;   // range of rows in order_
+      int left, right;  // children (-1 in leaves)
+      std::vector<double> hull;             // [lo,up] of every real attribute
+      std::vector<bool> real_missing;       // some instance misses the value
+      std::vector<double> min_distances;    // min over the instances of the
+                                            // distance to each category (0 if
+                                            // some instance misses the value)
+    };
+
+    struct Nearest
+    {
+      int row;
+      double dist;
+    };
+
+    static const int LEAF_SIZE;
+
+    int build_node(int begin, int end);
+
+    double dissimilarity(int row1, int row2) const;
+
+    double lower_bound(const Node& node, const Rule& rule) const;
+
+    void search(int node_idx, const Rule& rule, Nearest& nearest) const;
+
+    const Dataframe* df_;
+    std::vector<int> order_;     // rows grouped by class
+    std::vector<int> roots_;     // [class code], -1 if there are no instances
+    std::vector<int> offsets_;   // of each nominal attribute in min_distances
+    std::vector<Node> nodes_;
+};
+
+} /* end namespace rise */
+
+#endif
+
@@ -0,0 +1,69 @@
+#include "dataframe.h"
+#include "instance_index.h"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+/* Compares the nearest uncovered instance found by the index with a linear scan */
+int main(int argc, char* argv[])
+{
+  srand(42);
+  if (argc != 2)
+  {
+    std::cerr << "Usage: instance_index_test datasetname\n";
+    return -1;
+  }
+  try
+  {
+    std::string datafile = std::string("../Data/") + argv[1] + '/' + argv[1] + ".data";
+    std::string metafile = std::string("../Data/") + argv[1] + '/' + argv[1] + ".meta";
+    rise::Dataframe df(datafile, metafile);
+    df.shuffle();
+    df.init_lu(rise::Dataframe::SVDM);
+    const std::vector<rise::Instance>& instances = df.get_instances();
+    std::vector<rise::Rule::Ptr> rules;
+    for (const rise::Instance& instance : instances)
+    {
+      auto rule = std::make_shared<rise::Rule>(instance);
+      // generalize every other rule so the rules are not only points
+      if (rules.size()%2) rule = rule->adapt(instances[rand()%instances.size()]);
+      rules.push_back(rule);
+    }
+    rise::InstanceIndex index;
+    index.build(df);
+    int mismatches = 0;
+    double elapsed_linear = 0, elapsed_index = 0;
+    for (const rise::Rule::Ptr& rule : rules)
+    {
+      auto start = std::chrono::steady_clock::now();
+      const rise::Instance* nearest = nullptr;
+      double min_dist = std::numeric_limits<double>::infinity();
+      for (const rise::Instance& instance : instances)
+      {
+        if (instance.get_class_code() != rule->get_consequent_code()) continue;
+        double dist = rule->distance(instance);
+        if (dist > 1e-9 and dist < min_dist)
+        {
+          min_dist = dist;
+          nearest = &instance;
+        }
+      }
+      auto middle = std::chrono::steady_clock::now();
+      double index_dist;
+      const rise::Instance* index_nearest = index.nearest(*rule, index_dist);
+      auto end = std::chrono::steady_clock::now();
+      elapsed_linear += std::chrono::duration<double>(middle - start).count();
+      elapsed_index += std::chrono::duration<double>(end - middle).count();
+      if (nearest != index_nearest) ++mismatches;
+    }
+    std::cout << "#Rules: " << rules.size() << std::endl;
+    std::cout << "#Mismatches with linear scan: " << mismatches << std::endl;
+    std::cout << "Linear scan(s): " << elapsed_linear << std::endl;
+    std::cout << "Index(s): " << elapsed_index << std::endl;
+  }
+  catch (rise::RiseException& ex)
+  {
+    std::cerr << ex.what() << '\n';
+  }
+}
@@ -0,0 +1,57 @@
+
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rise
+{
+
+int resolve_num_threads(int num_threads)
+{
+  if (num_threads > 0) return num_threads;
+  int hw = std::thread::hardware_concurrency();
+  return hw > 0? hw : 1;
+}
+
+void parallel_for(int n, int num_threads, const std::function<void(int)>& body)
+{
+  num_threads = std::min(resolve_num_threads(num_threads), n);
+  if (num_threads <= 1)
+  {
+    for (int idx = 0; idx < n; ++idx) body(idx);
+    return;
+  }
+  std::atomic<int> next(0);
+  std::exception_ptr error;
+  std::mutex error_mtx;
+  auto worker = [&]()
+  {
+    int idx;
+    while ((idx = next++) < n)
+    {
+      try
+      {
+        body(idx);
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> lock(error_mtx);
+        if (not error) error = std::current_exception();
+        next = n; // stop handing out work
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads-1);
+  for (int idx = 1; idx < num_threads; ++idx) threads.emplace_back(worker);
+  worker();
+  for (std::thread& thread : threads) thread.join();
+  if (error) std::rethrow_exception(error);
+}
+
+} /* end namespace rise */
+
@@ -0,0 +1,26 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <functional>
+
+namespace rise
+{
+
+/*
+ * Number of threads to use when the user asks for num_threads (non-positive
+ * values select as many threads as hardware threads are available).
+ */
+int resolve_num_threads(int num_threads);
+
+/*
+ * Calls body(idx) for every idx in [0, n) using up to num_threads threads.
+ * Indices are handed out dynamically, so the order in which they are processed
+ * is unspecified. If any call throws, the first exception is rethrown in the
+ * calling thread once all the workers have finished.
+ */
+void parallel_for(int n, int num_threads, const std::function<void(int)>& body);
+
+} /* end namespace rise */
+
+#endif
+
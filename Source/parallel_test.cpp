@@ -0,0 +1,31 @@
+
+#include "common.h"
+#include "parallel.h"
+#include <iostream>
+#include <vector>
+
+int main(int argc, char* argv[])
+{
+  int num_threads = argc > 1? std::stoi(argv[1]) : 0;
+  std::vector<long> squares(1000);
+  rise::parallel_for(squares.size(), num_threads, [&](int idx)
+  {
+    squares[idx] = (long)idx*idx;
+  });
+  long sum = 0;
+  for (long square : squares) sum += square;
+  std::cout << "#Threads: " << rise::resolve_num_threads(num_threads) << std::endl;
+  std::cout << "Sum of squares below 1000: " << sum << " (expected 332833500)" << std::endl;
+  try
+  {
+    rise::parallel_for(100, num_threads, [](int idx)
+    {
+      if (idx == 42) throw rise::RiseException("error in task 42");
+    });
+  }
+  catch (rise::RiseException& ex)
+  {
+    std::cout << "Exception forwarded: " << ex.what() << std::endl;
+  }
+}
+
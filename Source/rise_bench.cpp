@@ -0,0 +1,344 @@
+#include "algorithm.h"
+#include "evaluation.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+struct Options
+{
+  std::vector<std::string> datasets; // all the ones in ../Data if none is given
+  int folds = 5;
+  uint64_t seed = 42;
+  int threads = 1;
+  int parallel_folds = 1;
+  std::string report; // standard output if empty
+  bool csv = false;
+};
+
+/*
+ * One run of the stratified cross validation of a data set with a distance.
+ * Times are in seconds; the phases are summed over all the folds.
+ */
+struct Run
+{
+  std::string dataset, distance, status = "ok";
+  int records = 0;
+  double accuracy = 0, accuracy_stdev = 0, rules = 0;
+  double wall_time = 0, cpu_time = 0;
+  long peak_rss_kb = 0;
+  double load_time = 0, split_time = 0, lu_time = 0, train_time = 0, test_time = 0;
+};
+
+const std::vector<std::pair<std::string, rise::Dataframe::NDistance>> DISTANCES = {
+  {"godel", rise::Dataframe::GODEL}, {"svdm", rise::Dataframe::SVDM}, {"kl", rise::Dataframe::KL}
+};
+
+std::string datafile(const std::string& dataset)
+{
+  return "../Data/" + dataset + '/' + dataset + ".data";
+}
+
+std::string metafile(const std::string& dataset)
+{
+  return "../Data/" + dataset + '/' + dataset + ".meta";
+}
+
+// sorted names of the folders of ../Data with a data and a meta file
+std::vector<std::string> list_datasets()
+{
+  std::vector<std::string> datasets;
+  DIR* dir = opendir("../Data");
+  if (dir == nullptr) return datasets;
+  while (dirent* entry = readdir(dir))
+  {
+    std::string name(entry->d_name);
+    if (name.empty() or name[0] == '.') continue;
+    if (std::ifstream(datafile(name)) and std::ifstream(metafile(name))) datasets.push_back(name);
+  }
+  closedir(dir);
+  std::sort(datasets.begin(), datasets.end());
+  return datasets;
+}
+
+bool read_options(int argc, char* argv[], Options& options)
+{
+  for (int idx = 1; idx < argc; ++idx)
+  {
+    std::string arg(argv[idx]);
+    if (arg == "-f")
+    {
+      if (++idx == argc) return false;
+      options.folds = std::stoi(argv[idx]);
+    }
+    else if (arg == "-S")
+    {
+      if (++idx == argc) return false;
+      options.seed = std::stoull(argv[idx]);
+    }
+    else if (arg == "-t")
+    {
+      if (++idx == argc) return false;
+      options.threads = std::stoi(argv[idx]);
+    }
+    else if (arg == "-p")
+    {
+      if (++idx == argc) return false;
+      options.parallel_folds = std::stoi(argv[idx]);
+    }
+    else if (arg == "-o")
+    {
+      if (++idx == argc) return false;
+      options.report = argv[idx];
+    }
+    else if (arg == "-F")
+    {
+      if (++idx == argc) return false;
+      std::string format(argv[idx]);
+      if (format == "csv") options.csv = true;
+      else if (format == "json") options.csv = false;
+      else return false;
+    }
+    else if (not arg.empty() and arg[0] == '-') return false;
+    else options.datasets.push_back(arg);
+  }
+  if (options.datasets.empty()) options.datasets = list_datasets();
+  return not options.datasets.empty();
+}
+
+/*
+ * Body of the child process of a run: the phases, accuracy and rules are
+ * written to fd as text (or '!' and the error message).
+ */
+void bench(const Options& options, const std::string& dataset,
+    rise::Dataframe::NDistance dtype, int fd)
+{
+  srand(42); // reproducible results
+  std::ostringstream out;
+  out.precision(17);
+  try
+  {
+    auto start = std::chrono::steady_clock::now();
+    rise::Dataframe df(datafile(dataset), metafile(dataset), ',', options.threads);
+    double load_time = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    std::vector<rise::Fold> folds = rise::stratified_kfold(df, options.folds, options.seed);
+    std::vector<rise::FoldResult> results = rise::evaluate(df, folds, dtype, 1.0,
+        options.parallel_folds, options.threads);
+    std::vector<double> acc_fold;
+    double rules = 0, split_time = 0, lu_time = 0, train_time = 0, test_time = 0;
+    for (const rise::FoldResult& result : results)
+    {
+      acc_fold.push_back(result.accuracy);
+      rules += result.n_rules;
+      split_time += result.split_time;
+      lu_time += result.lu_time;
+      train_time += result.train_time;
+      test_time += result.test_time;
+    }
+    double mean_acc, stdev_acc;
+    rise::mean_stdev(acc_fold, mean_acc, stdev_acc);
+    out << df.get_number_of_records() << ' ' << mean_acc << ' ' << stdev_acc << ' '
+        << rules/results.size() << ' ' << load_time << ' ' << split_time << ' ' << lu_time << ' '
+        << train_time << ' ' << test_time;
+  }
+  catch (std::exception& ex)
+  {
+    out << '!' << ex.what();
+  }
+  std::string text = out.str();
+  for (size_t written = 0; written < text.size(); )
+  {
+    ssize_t n = write(fd, text.data() + written, text.size() - written);
+    if (n <= 0) break;
+    written += n;
+  }
+}
+
+/*
+ * Every run is done by a child process, so the CPU time and the peak resident
+ * set size that the kernel gives for it (see wait4) only account for that
+ * run, and nothing is left from earlier runs (allocations, lookup tables...).
+ */
+Run run(const Options& options, const std::string& dataset,
+    const std::pair<std::string, rise::Dataframe::NDistance>& distance)
+{
+  Run result;
+  result.dataset = dataset;
+  result.distance = distance.first;
+  int fds[2];
+  if (pipe(fds) != 0)
+  {
+    result.status = std::string("pipe failed: ") + std::strerror(errno);
+    return result;
+  }
+  std::cout.flush();
+  std::cerr.flush();
+  auto start = std::chrono::steady_clock::now();
+  pid_t pid = fork();
+  if (pid < 0)
+  {
+    result.status = std::string("fork failed: ") + std::strerror(errno);
+    close(fds[0]);
+    close(fds[1]);
+    return result;
+  }
+  if (pid == 0)
+  {
+    close(fds[0]);
+    bench(options, dataset, distance.second, fds[1]);
+    close(fds[1]);
+    _exit(0);
+  }
+  close(fds[1]);
+  std::string text;
+  char buffer[4096];
+  ssize_t n;
+  while ((n = read(fds[0], buffer, sizeof(buffer))) > 0) text.append(buffer, n);
+  close(fds[0]);
+  int status;
+  rusage usage;
+  if (wait4(pid, &status, 0, &usage) != pid)
+  {
+    result.status = std::string("wait failed: ") + std::strerror(errno);
+    return result;
+  }
+  result.wall_time = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  result.cpu_time = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec*1e-6 +
+                    usage.ru_stime.tv_sec + usage.ru_stime.tv_usec*1e-6;
+  result.peak_rss_kb = usage.ru_maxrss; // kilobytes in Linux
+  if (not WIFEXITED(status) or WEXITSTATUS(status) != 0)
+  {
+    result.status = "child process failed";
+  }
+  else if (text.empty()) result.status = "no results";
+  else if (text[0] == '!') result.status = text.substr(1);
+  else
+  {
+    std::istringstream in(text);
+    in >> result.records >> result.accuracy >> result.accuracy_stdev >> result.rules
+       >> result.load_time >> result.split_time >> result.lu_time >> result.train_time
+       >> result.test_time;
+    if (not in) result.status = "malformed results";
+  }
+  return result;
+}
+
+std::string json_string(const std::string& text)
+{
+  std::string quoted = "\"";
+  for (char c : text)
+  {
+    if (c == '"' or c == '\\') quoted += '\\';
+    if (static_cast<unsigned char>(c) < 0x20) quoted += ' ';
+    else quoted += c;
+  }
+  return quoted + '"';
+}
+
+void write_json(std::ostream& out, const Options& options, const std::vector<Run>& runs)
+{
+  out << "{\n"
+      << "  \"compiler\": " << json_string(__VERSION__) << ",\n"
+      << "  \"folds\": " << options.folds << ",\n"
+      << "  \"seed\": " << options.seed << ",\n"
+      << "  \"threads\": " << options.threads << ",\n"
+      << "  \"parallel_folds\": " << options.parallel_folds << ",\n"
+      << "  \"runs\": [";
+  for (int idx = 0; idx < runs.size(); ++idx)
+  {
+    const Run& r = runs[idx];
+    out << (idx? ",\n" : "\n")
+        << "    {\"dataset\": " << json_string(r.dataset)
+        << ", \"distance\": " << json_string(r.distance)
+        << ", \"status\": " << json_string(r.status)
+        << ", \"records\": " << r.records
+        << ", \"accuracy\": " << r.accuracy
+        << ", \"accuracy_stdev\": " << r.accuracy_stdev
+        << ", \"rules\": " << r.rules
+        << ", \"wall_time\": " << r.wall_time
+        << ", \"cpu_time\": " << r.cpu_time
+        << ", \"peak_rss_kb\": " << r.peak_rss_kb
+        << ", \"phases\": {\"load\": " << r.load_time
+        << ", \"split\": " << r.split_time
+        << ", \"lookup_tables\": " << r.lu_time
+        << ", \"train\": " << r.train_time
+        << ", \"test\": " << r.test_time << "}}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+void write_csv(std::ostream& out, const Options& options, const std::vector<Run>& runs)
+{
+  out << "dataset,distance,status,folds,seed,threads,parallel_folds,records,accuracy,"
+      << "accuracy_stdev,rules,wall_time,cpu_time,peak_rss_kb,load_time,split_time,"
+      << "lookup_tables_time,train_time,test_time\n";
+  for (const Run& r : runs)
+  {
+    std::string status = r.status;
+    std::replace(status.begin(), status.end(), ',', ';');
+    std::replace(status.begin(), status.end(), '\n', ' ');
+    out << r.dataset << ',' << r.distance << ',' << status << ',' << options.folds << ','
+        << options.seed << ',' << options.threads << ',' << options.parallel_folds << ','
+        << r.records << ',' << r.accuracy << ',' << r.accuracy_stdev << ',' << r.rules << ','
+        << r.wall_time << ',' << r.cpu_time << ',' << r.peak_rss_kb << ',' << r.load_time << ','
+        << r.split_time << ',' << r.lu_time << ',' << r.train_time << ',' << r.test_time << '\n';
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  Options options;
+  if (not read_options(argc, argv, options))
+  {
+    std::cerr << "Usage: " << argv[0] << " [datasetname ...] [-f #folds] [-S seed] [-t #threads] [-p #parallel_folds] [-o reportfile] [-F {json|csv}]\n";
+    return -1;
+  }
+  /* progress goes to the standard error, so the standard output only has the
+   * report when no report file is given */
+  std::vector<Run> runs;
+  int failed = 0;
+  for (const std::string& dataset : options.datasets)
+  {
+    for (const auto& distance : DISTANCES)
+    {
+      std::cerr << dataset << ' ' << distance.first << ": " << std::flush;
+      runs.push_back(run(options, dataset, distance));
+      const Run& r = runs.back();
+      if (r.status != "ok")
+      {
+        ++failed;
+        std::cerr << r.status << std::endl;
+        continue;
+      }
+      std::cerr << "accuracy " << 100*r.accuracy << "%, " << r.rules << " rules, "
+                << r.wall_time << "s wall, " << r.cpu_time << "s cpu, "
+                << r.peak_rss_kb << "KB peak RSS" << std::endl;
+    }
+  }
+  std::ofstream file;
+  if (not options.report.empty())
+  {
+    file.open(options.report);
+    if (not file)
+    {
+      std::cerr << "Unable to write " << options.report << '\n';
+      return -1;
+    }
+  }
+  std::ostream& out = options.report.empty()? std::cout : file;
+  out.precision(10);
+  if (options.csv) write_csv(out, options, runs);
+  else write_json(out, options, runs);
+  return failed? 1 : 0;
+}
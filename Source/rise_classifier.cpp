@@ -1,57 +1,112 @@
 #include "algorithm.h"
-#include <cmath>
+#include "evaluation.h"
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
 
 struct Options
 {
-  std::string datafile, metafile;
+  std::string datafile, metafile, snapshot, model;
   rise::Dataframe::NDistance dtype;
-  double q;
+  double q = 1.0;
   int folds;
+  int threads = 1;
+  int parallel_folds = 1;
+  bool stratified = false;
+  uint64_t seed = 42;
+  int repetitions = 1;
+  double holdout = 0; // fraction of validation rows (0 means cross validation)
 };
 
 bool read_options(int argc, char* argv[], Options& options)
 {
-  if (argc < 4) return false;
-  if (argc > 5) return false;
-  options.datafile = std::string("../Data/") + argv[1] + '/' + argv[1] + ".data";
-  options.metafile = std::string("../Data/") + argv[1] + '/' + argv[1] + ".meta";
-  std::string dtype = std::string(argv[2]);
+  std::vector<std::string> args;
+  for (int idx = 1; idx < argc; ++idx)
+  {
+    std::string arg(argv[idx]);
+    if (arg == "-t")
+    {
+      if (++idx == argc) return false;
+      options.threads = std::stoi(argv[idx]);
+    }
+    else if (arg == "-p")
+    {
+      if (++idx == argc) return false;
+      options.parallel_folds = std::stoi(argv[idx]);
+    }
+    else if (arg == "-s")
+    {
+      if (++idx == argc) return false;
+      options.snapshot = argv[idx];
+    }
+    else if (arg == "-m")
+    {
+      if (++idx == argc) return false;
+      options.model = argv[idx];
+    }
+    else if (arg == "-S")
+    {
+      if (++idx == argc) return false;
+      options.stratified = true;
+      options.seed = std::stoull(argv[idx]);
+    }
+    else if (arg == "-r")
+    {
+      if (++idx == argc) return false;
+      options.stratified = true;
+      options.repetitions = std::stoi(argv[idx]);
+      if (options.repetitions < 1) return false;
+    }
+    else if (arg == "-H")
+    {
+      if (++idx == argc) return false;
+      options.stratified = true;
+      options.holdout = std::stod(argv[idx]);
+    }
+    else args.push_back(arg);
+  }
+  if (args.size() < 3) return false;
+  if (args.size() > 4) return false;
+  options.datafile = "../Data/" + args[0] + '/' + args[0] + ".data";
+  options.metafile = "../Data/" + args[0] + '/' + args[0] + ".meta";
+  std::string dtype = args[1];
   if (dtype == "godel") options.dtype = rise::Dataframe::GODEL;
   else if (dtype == "svdm") options.dtype = rise::Dataframe::SVDM;
   else if (dtype == "kl") options.dtype = rise::Dataframe::KL;
   else return false;
   if (dtype == "svdm")
   {
-    options.q = std::stod(argv[3]);
-    options.folds = std::stoi(argv[4]);
+    if (args.size() != 4) return false;
+    options.q = std::stod(args[2]);
+    options.folds = std::stoi(args[3]);
   }
   else
   {
-    options.folds = std::stoi(argv[3]);
+    if (args.size() != 3) return false;
+    options.folds = std::stoi(args[2]);
   }
   std::cout << "Options:\n"
             << "  datafile: " << options.datafile << '\n'
             << "  metafile: " << options.metafile << '\n'
             << "  dtype: " << dtype << '\n'
             << "  q (only relevand in svdm): " << options.q << '\n'
-            << "  folds: " << options.folds << std::endl;
-  return true;
-}
-
-void stats(const std::vector<double>& v, double& mean, double& stdev)
-{
-  double mean_sq = 0;
-  mean = 0;
-  for (double n : v)
+            << "  folds: " << options.folds << '\n'
+            << "  threads (0 means all available): " << options.threads << '\n'
+            << "  parallel folds (0 means all available cores): " << options.parallel_folds << '\n'
+            << "  snapshot: " << (options.snapshot.empty()? "none" : options.snapshot) << '\n'
+            << "  model: " << (options.model.empty()? "none" : options.model) << '\n'
+            << "  evaluation: ";
+  if (not options.stratified) std::cout << "consecutive folds of the shuffled data";
+  else
   {
-    mean += n;
-    mean_sq += n*n;
+    if (options.holdout > 0) std::cout << "stratified hold-out of " << options.holdout;
+    else std::cout << "stratified folds";
+    std::cout << " (seed " << options.seed << ", " << options.repetitions << " repetitions)";
   }
-  mean /= v.size();
-  mean_sq /= v.size();
-  stdev = std::sqrt(mean_sq - mean*mean);
+  std::cout << std::endl;
+  return true;
 }
 
 int main(int argc, char* argv[])
@@ -60,40 +115,72 @@ int main(int argc, char* argv[])
   Options options;
   if (not read_options(argc, argv, options))
   {
-    std::cerr << "Usage: " << argv[0] << " datasetname {godel|svdm|kl} [q] #folds\n";
+    std::cerr << "Usage: " << argv[0] << " datasetname {godel|svdm|kl} [q] #folds [-t #threads] [-p #parallel_folds] [-s snapshotfile] [-m modelfile] [-S seed] [-r #repetitions] [-H holdout_fraction]\n";
     return -1;
   }
   try
   {
-    rise::Dataframe df(options.datafile, options.metafile);
-    df.shuffle();
+    /* the snapshot (if any) is taken before shuffling, so the results are the
+     * same whether the data file is parsed or the snapshot is loaded */
+    std::unique_ptr<rise::Dataframe> df_ptr;
+    if (not options.snapshot.empty() and std::ifstream(options.snapshot))
+    {
+      df_ptr.reset(new rise::Dataframe());
+      df_ptr->load(options.snapshot);
+    }
+    else
+    {
+      df_ptr.reset(new rise::Dataframe(options.datafile, options.metafile, ',', options.threads));
+      if (not options.snapshot.empty()) df_ptr->save(options.snapshot);
+    }
+    rise::Dataframe& df = *df_ptr;
+    // stratified folds are drawn from their own seeded generators
+    if (not options.stratified) df.shuffle();
     std::cout << df << std::endl;
     if (options.folds == 1)
     {
-      df.init_lu(options.dtype, options.q);
-      rise::RiseClassifier classifier(true);
+      df.init_lu(options.dtype, options.q, options.threads);
+      std::cout << "Lookup table build times(s):";
+      const rise::Schema& schema = *df.get_schema();
+      for (int slot = 0; slot < schema.nominal_columns.size(); ++slot)
+      {
+        std::cout << ' ' << schema.nominal_meta[slot]->get_name() << '=' << df.get_lu_times()[slot];
+      }
+      std::cout << std::endl;
+      rise::RiseClassifier classifier(true, options.threads);
       classifier.train(df);
       std::cout << classifier << std::endl;
+      if (not options.model.empty()) classifier.save(options.model);
     }
     else
     {
-      std::vector<double> acc_fold(options.folds);
-      std::vector<double> elapsed_fold(options.folds);
-      rise::Dataframe train, val;
-      rise::RiseClassifier classifier(false);
-      for (int fold = 0; fold < options.folds; ++fold)
+      std::vector<rise::Fold> folds;
+      if (not options.stratified) folds = rise::kfold(df, options.folds);
+      else if (options.holdout > 0)
+      {
+        folds = rise::stratified_holdout(df, options.holdout, options.repetitions, options.seed);
+      }
+      else
+      {
+        folds = rise::repeated_stratified_kfold(df, options.folds, options.repetitions,
+                                                options.seed);
+      }
+      std::vector<rise::FoldResult> results = rise::evaluate(df, folds, options.dtype, options.q,
+          options.parallel_folds, options.threads);
+      std::vector<double> acc_fold, elapsed_fold;
+      for (const rise::FoldResult& result : results)
+      {
+        acc_fold.push_back(result.accuracy);
+        elapsed_fold.push_back(result.train_time);
+      }
+      for (int fold = 0; fold < results.size(); ++fold)
       {
-        df.split(fold, options.folds, train, val);
-        train.init_lu(options.dtype, options.q);
-        classifier.train(train);
-        elapsed_fold[fold] = classifier.get_train_time();
-        acc_fold[fold] = classifier.test(val);
         std::cout << "Accuracy in fold " << fold << "(%): " << 100*acc_fold[fold] << std::endl;
         std::cout << "Train time in fold " << fold << "(s): " << elapsed_fold[fold] << std::endl;
       }
       double mean_acc, stdev_acc, mean_elapsed, stdev_elapsed;
-      stats(acc_fold, mean_acc, stdev_acc);
-      stats(elapsed_fold, mean_elapsed, stdev_elapsed);
+      rise::mean_stdev(acc_fold, mean_acc, stdev_acc);
+      rise::mean_stdev(elapsed_fold, mean_elapsed, stdev_elapsed);
       std::cout << "Accuracy(%): " << mean_acc*100.0 << " (+- " << stdev_acc*100.0 << ')' << std::endl;
       std::cout << "Elapsed(s): " << mean_elapsed << " (+- " << stdev_elapsed << ')' << std::endl;
     }
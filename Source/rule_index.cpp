@@ -0,0 +1,251 @@
+#include "rule_index.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace rise
+{
+
+namespace /* utils for internal usage */
+{
+
+// the lower bounds are not computed exactly as the distances, so a bit of
+// slack (on top of the 1e-9 tolerance used to detect ties) avoids pruning ties
+const double PRUNE_SLACK = 2e-9;
+
+} /* end anonymous namespace */
+
+const int RuleIndex::LEAF_SIZE = 8;
+
+void RuleIndex::build(const std::vector<Rule::Ptr>& rules)
+{
+  clear();
+  if (rules.empty()) return;
+  rules_ = rules;
+  schema_ = rules_[0]->get_schema();
+  order_.resize(rules_.size());
+  for (int idx = 0; idx < order_.size(); ++idx) order_[idx] = idx;
+  nodes_.reserve(2*(rules_.size()/LEAF_SIZE + 1));
+  build_node(0, rules_.size());
+}
+
+void RuleIndex::clear()
+{
+  rules_.clear();
+  order_.clear();
+  nodes_.clear();
+  schema_.reset();
+}
+
+Rule::Ptr RuleIndex::nearest(const Instance& instance, double& min_dist, bool loo) const
+{
+  min_dist = std::numeric_limits<double>::infinity();
+  if (rules_.empty()) return Rule::Ptr();
+  Winner winner;
+  winner.rule = rules_[0].get();
+  winner.rank = 0;
+  winner.dist = rules_[0]->distance(instance);
+  // a NaN distance cannot be beaten (every comparison with it is false)
+  if (not std::isnan(winner.dist)) search(0, instance, loo, winner);
+  min_dist = winner.dist;
+  return rules_[winner.rank];
+}
+
+int RuleIndex::build_node(int begin, int end)
+{
+  const Schema& schema = *schema_;
+  int n_real = schema.real_columns.size();
+  int n_nominal = schema.nominal_columns.size();
+  int node_idx = nodes_.size();
+  nodes_.push_back(Node());
+  Node node;
+  node.begin = begin;
+  node.end = end;
+  node.left = node.right = -1;
+  node.hull.resize(2*n_real);
+  node.real_dropped.assign(n_real, false);
+  for (int k = 0; k < n_real; ++k)
+  {
+    node.hull[2*k] = std::numeric_limits<double>::infinity();
+    node.hull[2*k+1] = -std::numeric_limits<double>::infinity();
+  }
+  std::vector<std::vector<uint32_t>> categories(n_nominal);
+  std::vector<bool> nominal_dropped(n_nominal, false);
+  for (int idx = begin; idx < end; ++idx)
+  {
+    const Rule& rule = *rules_[order_[idx]];
+    const std::vector<double>& bounds = rule.get_bounds();
+    for (int k = 0; k < n_real; ++k)
+    {
+      if (std::isnan(bounds[2*k])) node.real_dropped[k] = true;
+      else
+      {
+        node.hull[2*k] = std::min(node.hull[2*k], bounds[2*k]);
+        node.hull[2*k+1] = std::max(node.hull[2*k+1], bounds[2*k+1]);
+      }
+    }
+    for (int k = 0; k < n_nominal; ++k)
+    {
+      uint32_t category = rule.get_categories()[k];
+      if (category == Rule::DROPPED) nominal_dropped[k] = true;
+      else categories[k].push_back(category);
+    }
+  }
+  /* NaN distances are skipped (rules at a NaN distance never win anyway) */
+  int offset = 0;
+  for (int k = 0; k < n_nominal; ++k)
+  {
+    const NominalAttributeMeta& meta = *schema.nominal_meta[k];
+    std::sort(categories[k].begin(), categories[k].end());
+    categories[k].erase(std::unique(categories[k].begin(), categories[k].end()),
+                        categories[k].end());
+    node.min_distances.resize(offset + meta.get_domain_size(),
+        nominal_dropped[k]? 0 : std::numeric_limits<double>::infinity());
+    for (uint32_t code = 0; code < meta.get_domain_size(); ++code)
+    {
+      for (uint32_t category : categories[k])
+      {
+        double d = meta.lookup_distance(category, code);
+        if (d < node.min_distances[offset+code]) node.min_distances[offset+code] = d;
+      }
+    }
+    offset += meta.get_domain_size();
+  }
+  if (end - begin > LEAF_SIZE)
+  {
+    /* ball-tree like split: take two distant rules as pivots and sort the rules
+     * by how much closer they are to the first pivot than to the second one */
+    auto first = order_.begin() + begin;
+    auto last = order_.begin() + end;
+    auto farthest = [&](int from)
+    {
+      int far = *first;
+      double max_dist = -1;
+      for (auto it = first; it != last; ++it)
+      {
+        double dist = dissimilarity(*rules_[from], *rules_[*it]);
+        if (dist > max_dist)
+        {
+          max_dist = dist;
+          far = *it;
+        }
+      }
+      return far;
+    };
+    int pivot1 = farthest(*first);
+    int pivot2 = farthest(pivot1);
+    std::vector<std::pair<double,int>> keys;
+    keys.reserve(end - begin);
+    for (auto it = first; it != last; ++it)
+    {
+      double key = dissimilarity(*rules_[pivot1], *rules_[*it]) -
+                   dissimilarity(*rules_[pivot2], *rules_[*it]);
+      keys.push_back(std::make_pair(key, *it));
+    }
+    std::sort(keys.begin(), keys.end());
+    for (int idx = 0; idx < keys.size(); ++idx) order_[begin+idx] = keys[idx].second;
+    int middle = (begin + end)/2;
+    node.left = build_node(begin, middle);
+    node.right = build_node(middle, end);
+  }
+  nodes_[node_idx] = std::move(node);
+  return node_idx;
+}
+
+double RuleIndex::dissimilarity(const Rule& r1, const Rule& r2) const
+{
+  /* distance between the centers of the conditions (dropped conditions are
+   * close to anything) */
+  const Schema& schema = *schema_;
+  const std::vector<double>& bounds1 = r1.get_bounds();
+  const std::vector<double>& bounds2 = r2.get_bounds();
+  const std::vector<uint32_t>& categories1 = r1.get_categories();
+  const std::vector<uint32_t>& categories2 = r2.get_categories();
+  double dist_total = 0;
+  for (int k = 0; k < schema.real_columns.size(); ++k)
+  {
+    double center1 = (bounds1[2*k] + bounds1[2*k+1])/2;
+    double center2 = (bounds2[2*k] + bounds2[2*k+1])/2;
+    double d = std::fabs(center1 - center2)/schema.real_meta[k]->get_range();
+    if (d > 0) dist_total += d; // false for NaN
+  }
+  for (int k = 0; k < schema.nominal_columns.size(); ++k)
+  {
+    if (categories1[k] == Rule::DROPPED or categories2[k] == Rule::DROPPED) continue;
+    double d = schema.nominal_meta[k]->lookup_distance(categories1[k], categories2[k]);
+    if (d > 0) dist_total += d;
+  }
+  return dist_total;
+}
+
+double RuleIndex::lower_bound(const Node& node, const Instance& instance) const
+{
+  /* the distance of a rule is the sum of the distances of each attribute
+   * divided by the number of attributes taken into account, which is never
+   * greater than the number of attributes */
+  const Schema& schema = *schema_;
+  double dist_total = 0;
+  for (int k = 0; k < schema.real_columns.size(); ++k)
+  {
+    if (node.real_dropped[k]) continue;
+    double number = instance.get_real(schema.real_columns[k]);
+    if (std::isnan(number)) continue;
+    double lo = node.hull[2*k];
+    double up = node.hull[2*k+1];
+    if (number < lo) dist_total += (lo - number)/schema.real_meta[k]->get_range();
+    else if (number > up) dist_total += (number - up)/schema.real_meta[k]->get_range();
+  }
+  const double* min_distances = node.min_distances.data();
+  for (int k = 0; k < schema.nominal_columns.size(); ++k)
+  {
+    uint32_t code = instance.get_code(schema.nominal_columns[k]);
+    if (code != NominalAttributeMeta::MISSING) dist_total += min_distances[code];
+    min_distances += schema.nominal_meta[k]->get_domain_size();
+  }
+  return dist_total/schema.xmeta.size();
+}
+
+void RuleIndex::search(int node_idx, const Instance& instance, bool loo, Winner& winner) const
+{
+  const Node& node = nodes_[node_idx];
+  if (node.left < 0)
+  {
+    for (int idx = node.begin; idx < node.end; ++idx)
+    {
+      int rank = order_[idx];
+      if (rank == 0) continue; // the initial winner
+      const Rule& rule = *rules_[rank];
+      // rules farther than the winner (plus the tie tolerance) cannot win
+      double dist = rule.distance(instance, winner.dist + 1e-9);
+      if (loo and dist < 1e-9 and rule.get_n_instances_covered() < 2) continue;
+      bool wins = dist < winner.dist-1e-9;
+      if (not wins and std::fabs(dist - winner.dist) <= 1e-9)
+      {
+        double f1 = rule.get_f1_score();
+        double winner_f1 = winner.rule->get_f1_score();
+        // on a complete tie, the first rule of the linear scan is kept
+        wins = f1 > winner_f1 or (f1 == winner_f1 and rank < winner.rank);
+      }
+      if (wins)
+      {
+        winner.rule = &rule;
+        winner.rank = rank;
+        winner.dist = dist;
+      }
+    }
+    return;
+  }
+  double left_bound = lower_bound(nodes_[node.left], instance);
+  double right_bound = lower_bound(nodes_[node.right], instance);
+  int first = node.left, second = node.right;
+  if (right_bound < left_bound)
+  {
+    std::swap(first, second);
+    std::swap(left_bound, right_bound);
+  }
+  if (not (left_bound > winner.dist + PRUNE_SLACK)) search(first, instance, loo, winner);
+  if (not (right_bound > winner.dist + PRUNE_SLACK)) search(second, instance, loo, winner);
+}
+
+} /* end namespace rise */
+
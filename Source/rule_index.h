@@ -0,0 +1,83 @@
+#ifndef RULE_INDEX_H
+#define RULE_INDEX_H
+
+#include "rules.h"
+
+namespace rise
+{
+
+class RuleIndex;
+
+/*
+ * Tree over a set of rules (sharing the same Schema) that answers nearest
+ * rule queries without computing the distance to every rule. Each node keeps
+ * a summary of its rules (the hull of the intervals of each real attribute
+ * and the categories of each nominal attribute), from which a lower bound of
+ * the distance between any of its rules and an instance is derived. Subtrees
+ * whose bound cannot beat the best rule found so far are skipped.
+ *
+ * Queries return the same rule as a linear scan of the rules in the order in
+ * which they were given to build(): the first rule is the initial winner, and
+ * any other rule replaces the winner if it is closer (by more than 1e-9) or if
+ * it is as close and has a higher f1 score. In leave-one-out mode, rules other
+ * than the first one that only cover the instance itself are ignored.
+ */
+class RuleIndex
+{
+  public:
+
+    RuleIndex() {}
+
+    template <class Container>
+    void build(const Container& rules) { build(std::vector<Rule::Ptr>(rules.begin(), rules.end())); }
+
+    void build(const std::vector<Rule::Ptr>& rules);
+
+    void clear();
+
+    int size() const { return rules_.size(); }
+
+    // in the order in which they were given to build()
+    const std::vector<Rule::Ptr>& get_rules() const { return rules_; }
+
+    Rule::Ptr nearest(const Instance& instance, double& min_dist, bool loo=false) const;
+
+  private:
+
+    struct Node
+    {
+      int begin, end;   // range of rules in order_
+      int left, right;  // children (-1 in leaves)
+      std::vector<double> hull;             // [lo,up] of every real attribute
+      std::vector<bool> real_dropped;       // some rule has dropped the condition
+      std::vector<double> min_distances;    // min over the rules of the distance
+                                            // to each category (0 if dropped)
+    };
+
+    struct Winner
+    {
+      const Rule* rule;
+      int rank;
+      double dist;
+    };
+
+    static const int LEAF_SIZE;
+
+    int build_node(int begin, int end);
+
+    double dissimilarity(const Rule& r1, const Rule& r2) const;
+
+    double lower_bound(const Node& node, const Instance& instance) const;
+
+    void search(int node_idx, const Instance& instance, bool loo, Winner& winner) const;
+
+    std::vector<Rule::Ptr> rules_;
+    std::vector<int> order_;
+    std::vector<Node> nodes_;
+    Schema::Ptr schema_;
+};
+
+} /* end namespace rise */
+
+#endif
+
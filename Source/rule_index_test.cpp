@@ -0,0 +1,72 @@
+
+#include "dataframe.h"
+#include "rule_index.h"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+/* Compares the nearest rule found by the index with a linear scan */
+int main(int argc, char* argv[])
+{
+  srand(42);
+  if (argc != 2)
+  {
+    std::cerr << "Usage: rule_index_test datasetname\n";
+    return -1;
+  }
+  try
+  {
+    std::string datafile = std::string("../Data/") + argv[1] + '/' + argv[1] + ".data";
+    std::string metafile = std::string("../Data/") + argv[1] + '/' + argv[1] + ".meta";
+    rise::Dataframe df(datafile, metafile);
+    df.shuffle();
+    df.init_lu(rise::Dataframe::SVDM);
+    std::vector<rise::Rule::Ptr> rules;
+    for (const rise::Instance& instance : df.get_instances())
+    {
+      auto rule = std::make_shared<rise::Rule>(instance);
+      rule->evaluate_rule(df);
+      // generalize every other rule so the rules are not only points
+      if (rules.size()%2) rule = rule->adapt(df.get_instances()[rand()%df.get_number_of_records()]);
+      rule->evaluate_rule(df);
+      rules.push_back(rule);
+    }
+    rise::RuleIndex index;
+    index.build(rules);
+    int mismatches = 0;
+    double elapsed_linear = 0, elapsed_index = 0;
+    for (const rise::Instance& instance : df.get_instances())
+    {
+      auto start = std::chrono::steady_clock::now();
+      rise::Rule::Ptr winner = rules[0];
+      double min_dist = winner->distance(instance);
+      for (const rise::Rule::Ptr& rule : rules)
+      {
+        double dist = rule->distance(instance);
+        if (dist < 1e-9 and rule->get_n_instances_covered() < 2) continue;
+        if (dist < min_dist-1e-9 or (std::fabs(dist - min_dist) <= 1e-9 and
+              rule->get_f1_score() > winner->get_f1_score()))
+        {
+          min_dist = dist;
+          winner = rule;
+        }
+      }
+      auto middle = std::chrono::steady_clock::now();
+      double index_dist;
+      rise::Rule::Ptr index_winner = index.nearest(instance, index_dist, true);
+      auto end = std::chrono::steady_clock::now();
+      elapsed_linear += std::chrono::duration<double>(middle - start).count();
+      elapsed_index += std::chrono::duration<double>(end - middle).count();
+      if (winner != index_winner) ++mismatches;
+    }
+    std::cout << "#Rules: " << index.size() << std::endl;
+    std::cout << "#Mismatches with linear scan: " << mismatches << std::endl;
+    std::cout << "Linear scan(s): " << elapsed_linear << std::endl;
+    std::cout << "Index(s): " << elapsed_index << std::endl;
+  }
+  catch (rise::RiseException& ex)
+  {
+    std::cerr << ex.what() << '\n';
+  }
+}
+
@@ -1,277 +1,294 @@
 #include "rules.h"
 #include <cmath>
-#include <functional>
+#include <cstring>
 #include <limits>
-#include <typeinfo>
 
 namespace rise
 {
 
 namespace // tools for internal usage
 {
-} /* end anonymous namespace */
-
-// RealCondition's methods
 
-double RealCondition::EPSILON = 1e-7;
+// bit pattern of the bounds of dropped conditions in keys
+const uint64_t DROPPED_BOUND = 0x7ff8000000000000;
 
-bool RealCondition::covers(const Attribute::Ptr& attr) const
+// finalizer of splitmix64: every bit of the input affects every bit of the output
+inline uint64_t mix(uint64_t h)
 {
-  if (auto rattr = std::dynamic_pointer_cast<RealAttribute>(attr))
-  {
-    double number = rattr->get_number();
-    return number >= lower_bound_ and number <= upper_bound_;
-  }
-  return false;
+  h = (h ^ (h >> 30))*0xbf58476d1ce4e5b9;
+  h = (h ^ (h >> 27))*0x94d049bb133111eb;
+  return h ^ (h >> 31);
 }
 
-double RealCondition::distance(const Attribute::Ptr& attr) const
-{
-  auto meta = std::dynamic_pointer_cast<RealAttributeMeta>(get_meta());
-  if (auto rattr = std::dynamic_pointer_cast<RealAttribute>(attr))
-  {
-    double number = rattr->get_number();
-    if (number < lower_bound_) return (lower_bound_ - number)/meta->get_range();
-    else if (number > upper_bound_) return (number - upper_bound_)/meta->get_range();
-    else return 0;
-  }
-  return -1;
-}
+} /* end anonymous namespace */
 
-Condition::Ptr RealCondition::adapt(const Attribute::Ptr& attr) const
-{
-  double lo = lower_bound_;
-  double up = upper_bound_;
-  if (auto rattr = std::dynamic_pointer_cast<RealAttribute>(attr))
-  {
-    double number = rattr->get_number();
-    if (number < lower_bound_) lo = number;
-    else if (number > upper_bound_) up = number;
-  }
-  return std::make_shared<RealCondition>(get_meta(), lo, up);
-}
+// Rule's methods
 
-bool RealCondition::operator==(const Condition& other) const
-{
-  try
-  {
-    auto c = dynamic_cast<const RealCondition&>(other);
-    return std::fabs(lower_bound_ - c.lower_bound_) < EPSILON and 
-           std::fabs(upper_bound_ - c.upper_bound_) < EPSILON;
-  }
-  catch (std::bad_cast&)
-  {
-    return false;
-  }
-}
+constexpr uint32_t Rule::DROPPED;
 
-std::string RealCondition::to_str() const
-{
-  std::ostringstream oss;
-  oss << lower_bound_ << "<=" << get_meta()->get_name() << "<=" << upper_bound_;
-  return oss.str();
-}
-
-// NominalCondition's methods
+double Rule::EPSILON = 1e-7;
 
-bool NominalCondition::covers(const Attribute::Ptr& attr) const
+Rule::Rule(const Instance& instance) : schema_(instance.get_dataframe().get_schema())
 {
-  if (auto nattr = std::dynamic_pointer_cast<NominalAttribute>(attr))
+  const Schema& schema = *schema_;
+  consequent_ = instance.get_class_code();
+  bounds_.resize(2*schema.real_columns.size());
+  categories_.resize(schema.nominal_columns.size());
+  for (int idx = 0; idx < schema.real_columns.size(); ++idx)
   {
-    return nattr->get_category() == category_;
+    // a missing value yields NaN bounds, i.e. a dropped condition
+    double number = instance.get_real(schema.real_columns[idx]);
+    bounds_[2*idx] = bounds_[2*idx+1] = number;
   }
-  return false;
+  for (int idx = 0; idx < schema.nominal_columns.size(); ++idx)
+  {
+    // NominalAttributeMeta::MISSING and DROPPED share the same value
+    categories_[idx] = instance.get_code(schema.nominal_columns[idx]);
+  }
+  update_nominal_terms();
+  update_key();
 }
 
-double NominalCondition::distance(const Attribute::Ptr& attr) const
+Rule::Rule(const Schema::Ptr& schema, const std::vector<double>& bounds,
+    const std::vector<uint32_t>& categories, uint32_t consequent, int n_instances_covered,
+    int n_correctly_classified, int n_instances_same_class)
+  : schema_(schema), bounds_(bounds), categories_(categories), consequent_(consequent),
+    n_instances_covered_(n_instances_covered), n_correctly_classified_(n_correctly_classified),
+    n_instances_same_class_(n_instances_same_class)
 {
-  auto meta = std::dynamic_pointer_cast<NominalAttributeMeta>(get_meta());
-  if (auto nattr = std::dynamic_pointer_cast<NominalAttribute>(attr))
-  {
-    return meta->lookup_distance(category_, nattr->get_category());
-  }
-  return -1;
+  update_nominal_terms();
+  update_key();
+  update_scores();
 }
 
-Condition::Ptr NominalCondition::adapt(const Attribute::Ptr& attr) const
+const std::string& Rule::get_consequent() const
 {
-  if (auto nattr = std::dynamic_pointer_cast<NominalAttribute>(attr))
-  {
-    if (nattr->get_category() != category_) return Condition::Ptr();
-  }
-  return std::make_shared<NominalCondition>(get_meta(), category_);
+  return schema_->ymeta->get_category(consequent_);
 }
 
-bool NominalCondition::operator==(const Condition& other) const
+bool Rule::covers(const Instance& instance) const
 {
-  try
+  const Schema& schema = *schema_;
+  for (int idx = 0; idx < schema.real_columns.size(); ++idx)
   {
-    auto c = dynamic_cast<const NominalCondition&>(other);
-    return category_ == c.category_;
+    double lo = bounds_[2*idx];
+    double up = bounds_[2*idx+1];
+    if (std::isnan(lo)) continue;
+    double number = instance.get_real(schema.real_columns[idx]);
+    if (not (number >= lo and number <= up)) return false;
   }
-  catch (std::bad_cast&)
+  for (int idx = 0; idx < schema.nominal_columns.size(); ++idx)
   {
-    return false;
+    uint32_t category = categories_[idx];
+    if (category == DROPPED) continue;
+    if (instance.get_code(schema.nominal_columns[idx]) != category) return false;
   }
+  return true;
 }
 
-std::size_t NominalCondition::hash() const
-{
-  std::hash<std::string> h;
-  return h(category_);
-}
-
-std::string NominalCondition::to_str() const
+double Rule::distance(const Instance& instance) const
 {
-  std::ostringstream oss;
-  oss << get_meta()->get_name() << "=" << category_;
-  return oss.str();
+  return distance(instance, std::numeric_limits<double>::infinity());
 }
 
-// Rule's methods
-
-Rule::Rule(const Instance& instance, const std::vector<AttributeMeta::Ptr>& meta)
+double Rule::distance(const Instance& instance, double upper_bound) const
 {
-  const std::vector<Attribute::Ptr>& x = instance.get_x();
-  if (x.size() != meta.size()) throw RiseException("Different size of meta vector and x");
-  consequent_ = instance.get_y();
-  antecedent_.resize(instance.get_x().size());
-  for (int idx = 0; idx < x.size(); ++idx)
+  /* the sum is divided by the number of attributes taken into account, which
+   * is never greater than the number of attributes, so the partial sum divided
+   * by the latter is a lower bound of the distance. Comparisons with a NaN
+   * bound (or a NaN partial sum) are false, so they never abandon */
+  const Schema& schema = *schema_;
+  const double n_attrs = schema.xmeta.size();
+  const double limit = upper_bound*n_attrs;
+  double dist_total = 0.0;
+  // dropped conditions count as attributes at distance 0 (real ones below)
+  int count = schema.nominal_columns.size() - nominal_terms_.size();
+  for (int idx = 0; idx < schema.real_columns.size(); ++idx)
   {
-    if (auto rattr = std::dynamic_pointer_cast<RealAttribute>(x[idx]))
+    double lo = bounds_[2*idx];
+    double up = bounds_[2*idx+1];
+    if (std::isnan(lo))
     {
-      antecedent_[idx] = std::make_shared<RealCondition>(
-          meta[idx], rattr->get_number(), rattr->get_number());
+      ++count;
+      continue;
     }
-    else if (auto nattr = std::dynamic_pointer_cast<NominalAttribute>(x[idx]))
+    double number = instance.get_real(schema.real_columns[idx]);
+    if (std::isnan(number)) continue;
+    if (number < lo) dist_total += (lo - number)/schema.real_meta[idx]->get_range();
+    else if (number > up) dist_total += (number - up)/schema.real_meta[idx]->get_range();
+    ++count;
+    if (dist_total > limit and dist_total/n_attrs > upper_bound)
     {
-      antecedent_[idx] = std::make_shared<NominalCondition>(
-          meta[idx], nattr->get_category());
+      return std::numeric_limits<double>::infinity();
     }
   }
+  for (const NominalTerm& term : nominal_terms_)
+  {
+    uint32_t code = instance.get_code(term.column);
+    if (code == NominalAttributeMeta::MISSING) continue;
+    dist_total += term.row[code];
+    ++count;
+    if (dist_total > limit and dist_total/n_attrs > upper_bound)
+    {
+      return std::numeric_limits<double>::infinity();
+    }
+  }
+  dist_total /= count;
+  return dist_total;
 }
 
-const std::string& Rule::get_consequent() const
+Rule::Ptr Rule::adapt(const Instance& instance) const
 {
-  return std::dynamic_pointer_cast<NominalAttribute>(consequent_)->get_category();
+  auto rule = std::make_shared<Rule>(*this);
+  rule->adapt(instance, *rule);
+  return rule;
 }
 
-bool Rule::covers(const Instance& instance) const
+void Rule::adapt(const Instance& instance, Rule& rule) const
 {
-  const std::vector<Attribute::Ptr>& x = instance.get_x();
-  for (int idx = 0; idx < x.size(); ++idx)
+  const Schema& schema = *schema_;
+  if (&rule != this)
   {
-    if (antecedent_[idx] and not antecedent_[idx]->covers(x[idx])) return false;
+    // vectors keep their storage when they are assigned a vector of the same size
+    if (rule.schema_ != schema_) rule.schema_ = schema_;
+    rule.bounds_ = bounds_;
+    rule.categories_ = categories_;
+    rule.nominal_terms_ = nominal_terms_;
+    rule.consequent_ = consequent_;
   }
-  return true;
-}
-
-double Rule::distance(const Instance& instance) const
-{
-  const std::vector<Attribute::Ptr>& x = instance.get_x();
-  double dist_total = 0.0;
-  int count = 0;
-  for (int idx = 0; idx < x.size(); ++idx)
+  bool dropped = false;
+  for (int idx = 0; idx < schema.real_columns.size(); ++idx)
   {
-
-    if (not antecedent_[idx]) ++count;
-    else
+    double number = instance.get_real(schema.real_columns[idx]);
+    // comparisons with NaN (dropped condition or missing value) are false
+    if (number < rule.bounds_[2*idx]) rule.bounds_[2*idx] = number;
+    else if (number > rule.bounds_[2*idx+1]) rule.bounds_[2*idx+1] = number;
+  }
+  for (int idx = 0; idx < schema.nominal_columns.size(); ++idx)
+  {
+    uint32_t code = instance.get_code(schema.nominal_columns[idx]);
+    if (code != NominalAttributeMeta::MISSING and code != rule.categories_[idx])
     {
-      double d = antecedent_[idx]->distance(x[idx]);
-      if (d >= 0)
-      {
-        dist_total += d;
-        ++count;
-      }
+      rule.categories_[idx] = DROPPED;
+      dropped = true;
     }
   }
-  dist_total /= count;
-  return dist_total;
+  if (dropped) rule.update_nominal_terms();
+  rule.update_key();
 }
 
-Rule::Ptr Rule::adapt(const Instance& instance) const
+void Rule::evaluate_rule(const Dataframe& df)
 {
-  const std::vector<Attribute::Ptr>& x = instance.get_x();
-  auto rule = std::make_shared<Rule>(*this);
-  for (int idx = 0; idx < x.size(); ++idx)
+  /* the covered rows are the intersection of the rows that fulfill each of
+   * the conditions of the rule. Nominal conditions go first, keeping track of
+   * the words that are still non-zero, since they usually leave few rows */
+  const Schema& schema = *schema_;
+  const CoverageIndex& index = df.get_coverage_index();
+  covered_ = index.get_all();
+  // scratch space reused by the calls of each thread
+  static thread_local std::vector<int> words;
+  static thread_local Bitset scratch;
+  words.resize(covered_.size());
+  for (int idx = 0; idx < words.size(); ++idx) words[idx] = idx;
+  for (int idx = 0; idx < schema.nominal_columns.size(); ++idx)
   {
-    if (rule->antecedent_[idx])
+    if (categories_[idx] == DROPPED) continue;
+    const Bitset& rows = index.get_rows(schema.nominal_columns[idx], categories_[idx]);
+    int n_words = 0;
+    for (int word : words)
     {
-      rule->antecedent_[idx] = rule->antecedent_[idx]->adapt(x[idx]);
+      covered_[word] &= rows[word];
+      if (covered_[word]) words[n_words++] = word;
     }
+    words.resize(n_words);
   }
-  return rule;
+  for (int idx = 0; idx < schema.real_columns.size(); ++idx)
+  {
+    if (std::isnan(bounds_[2*idx])) continue;
+    index.intersect_interval(schema.real_columns[idx], bounds_[2*idx], bounds_[2*idx+1],
+                             covered_, scratch);
+  }
+  n_instances_covered_ = count(covered_);
+  n_correctly_classified_ = count_intersection(covered_, index.get_class_rows(consequent_));
+  n_instances_same_class_ = index.get_class_count(consequent_);
+  update_scores();
 }
 
-bool Rule::operator==(const Rule& other) const
+void Rule::update_nominal_terms()
 {
-
-  for (int idx = 0; idx < antecedent_.size(); ++idx)
+  const Schema& schema = *schema_;
+  nominal_terms_.clear();
+  for (int idx = 0; idx < schema.nominal_columns.size(); ++idx)
   {
-    if (antecedent_[idx] and other.antecedent_[idx] and
-        *antecedent_[idx] != *other.antecedent_[idx]) return false;
-    else if ((bool)antecedent_[idx] xor (bool)other.antecedent_[idx]) return false;
+    if (categories_[idx] == DROPPED) continue;
+    const NominalAttributeMeta& meta = *schema.nominal_meta[idx];
+    NominalTerm term;
+    term.column = schema.nominal_columns[idx];
+    // no lookup table yet (i.e. init_lu has not been called): no distances
+    term.row = meta.get_lookup().empty()? nullptr :
+               meta.get_lookup().data() + categories_[idx]*meta.get_domain_size();
+    nominal_terms_.push_back(term);
   }
-  return *consequent_ == *other.consequent_;;
 }
 
-void Rule::evaluate_rule(const Dataframe& df)
+void Rule::update_key()
 {
-  int instances_same_class = 0;
-  int correctly_classified = 0;
-  n_instances_covered_ = 0;
-  const std::string& rule_class = get_consequent();
-  for (const Instance& instance : df.get_instances())
+  /* rounding the bounds makes rules whose bounds only differ by rounding
+   * errors (up to EPSILON) equal (adding 0 turns -0 into 0) */
+  key_.assign(bounds_.size() + (categories_.size() + 1)/2 + 1, 0);
+  for (int idx = 0; idx < bounds_.size(); ++idx)
   {
-    auto instance_class = std::dynamic_pointer_cast<NominalAttribute>(instance.get_y());
-    if (covers(instance))
-    {
-      ++n_instances_covered_;
-      if (instance_class->get_category() == rule_class)
-      {
-        ++correctly_classified;
-      }
-    }
-    if (instance_class->get_category() == rule_class)
+    if (std::isnan(bounds_[idx])) key_[idx] = DROPPED_BOUND;
+    else
     {
-      ++instances_same_class;
+      double rounded = std::round(bounds_[idx]/EPSILON) + 0.0;
+      std::memcpy(&key_[idx], &rounded, sizeof(double));
     }
-    coverage_ = ((double)correctly_classified) / instances_same_class;
-    precision_ = ((double)correctly_classified) / n_instances_covered_;
   }
+  for (int idx = 0; idx < categories_.size(); ++idx)
+  {
+    key_[bounds_.size() + idx/2] |= uint64_t(categories_[idx]) << (32*(idx%2));
+  }
+  key_.back() = consequent_;
+  uint64_t h = key_.size();
+  for (uint64_t word : key_) h = mix(h ^ word);
+  hash_ = h;
 }
 
-std::size_t Rule::hash() const
+void Rule::update_scores()
 {
-  std::size_t h = 0;
-  std::hash<std::string> hs;
-  for (const auto& cond : antecedent_)
-  {
-    if (cond) h ^= cond->hash() + 0x9e3779b9 + (h<<6) + (h>>2);
-  }
-  h ^= hs(std::dynamic_pointer_cast<NominalAttribute>(consequent_)->get_category())
-    + 0x9e3779b9 + (h<<6) + (h>>2);
-  return h;
+  coverage_ = ((double)n_correctly_classified_) / n_instances_same_class_;
+  precision_ = ((double)n_correctly_classified_) / n_instances_covered_;
 }
 
 std::string Rule::to_str() const
 {
+  const Schema& schema = *schema_;
   std::ostringstream oss;
   bool first = true;
-  for (const auto& condition : antecedent_)
+  for (int column = 0; column < schema.xmeta.size(); ++column)
   {
-    if (condition)
+    int slot = schema.slots[column];
+    if (schema.is_real[column])
     {
+      if (std::isnan(bounds_[2*slot])) continue;
       if (not first) oss << ", ";
-      oss << *condition;
-      first = false;
+      oss << bounds_[2*slot] << "<=" << schema.xmeta[column]->get_name()
+          << "<=" << bounds_[2*slot+1];
     }
+    else
+    {
+      if (categories_[slot] == DROPPED) continue;
+      if (not first) oss << ", ";
+      oss << schema.xmeta[column]->get_name() << "="
+          << schema.nominal_meta[slot]->get_category(categories_[slot]);
+    }
+    first = false;
   }
-  oss << " -> " << *consequent_ << " (coverage: " << coverage_*100.0
+  oss << " -> " << get_consequent() << " (coverage: " << coverage_*100.0
       << "%, precision: " << precision_*100.0 << "%, f1: " << get_f1_score() << ')';
   return oss.str();
 }
 
 } /* end namespace rise */
 
-
@@ -9,136 +9,134 @@
 namespace rise
 {
 
-class Condition;
-class RealCondition;
-class NominalCondition;
 class Rule;
 
-class Condition : public Stringifiable
+/*
+ * The antecedent of a rule is stored in two packed arrays: one with the
+ * [lower, upper] bounds of each real attribute (NaN bounds mean that the
+ * condition has been dropped) and another with the category code of each
+ * nominal attribute (DROPPED means that the condition has been dropped).
+ * The order of the attributes in these arrays is given by the Schema.
+ */
+class Rule : public Stringifiable
 {
   public:
 
-    typedef std::shared_ptr<Condition> Ptr;
-
-    Condition(const AttributeMeta::Ptr& meta) : meta_(meta) {};
-
-    const AttributeMeta::Ptr& get_meta() const { return meta_; }
-
-    virtual bool covers(const Attribute::Ptr& attr) const = 0;
-
-    virtual double distance(const Attribute::Ptr& attr) const = 0;
-
-    virtual Ptr adapt(const Attribute::Ptr& attr) const = 0;
+    typedef std::shared_ptr<Rule> Ptr;
 
-    virtual bool operator==(const Condition& other) const = 0;
+    static constexpr uint32_t DROPPED = 0xffffffff;
 
-    virtual bool operator!=(const Condition& other) const
+    /*
+     * Nominal condition that has not been dropped: the column of its attribute
+     * and the row of the lookup table of the attribute for its category, so
+     * the distance to a (non-missing) code is row[code]. Rows point into the
+     * lookup tables, so they must not change (e.g. by init_lu) once rules have
+     * been created.
+     */
+    struct NominalTerm
     {
-      return not (*this == other);
-    }
-
-    virtual std::size_t hash() const = 0;
-
-  private:
-
-    AttributeMeta::Ptr meta_;
-};
-
-class RealCondition : public Condition
-{
-  public:
-
-    typedef std::shared_ptr<RealCondition> Ptr;
-
-    RealCondition(const AttributeMeta::Ptr& meta, double lo, double up)
-      : Condition(meta), lower_bound_(lo), upper_bound_(up) {}
-
-    virtual bool covers(const Attribute::Ptr& attr) const override;
-
-    virtual double distance(const Attribute::Ptr& attr) const override;
-
-    virtual Condition::Ptr adapt(const Attribute::Ptr& attr) const override;
-
-    virtual bool operator==(const Condition& other) const override;
-
-    virtual std::size_t hash() const override { return 0; } 
-
-    virtual std::string to_str() const override;
-
-  private:
-
-    static double EPSILON;
-
-    double lower_bound_, upper_bound_;
-};
+      int column;
+      const double* row;
+    };
 
-class NominalCondition : public Condition
-{
-  public:
+    explicit Rule(const Instance& instance);
 
-    typedef std::shared_ptr<NominalCondition> Ptr;
+    /*
+     * Rule with the given conditions and scores (e.g. read from a saved model).
+     * It has not been evaluated on any dataframe, so get_covered() is empty.
+     */
+    Rule(const Schema::Ptr& schema, const std::vector<double>& bounds,
+         const std::vector<uint32_t>& categories, uint32_t consequent,
+         int n_instances_covered, int n_correctly_classified, int n_instances_same_class);
 
-    NominalCondition(const AttributeMeta::Ptr& meta, const std::string& category)
-      : Condition(meta), category_(category) {}
+    const std::string& get_consequent() const;
 
-    virtual bool covers(const Attribute::Ptr& attr) const override;
+    uint32_t get_consequent_code() const { return consequent_; }
 
-    virtual double distance(const Attribute::Ptr& attr) const override;
+    const Schema::Ptr& get_schema() const { return schema_; }
 
-    virtual Condition::Ptr adapt(const Attribute::Ptr& attr) const  override;
+    const std::vector<double>& get_bounds() const { return bounds_; }
 
-    virtual bool operator==(const Condition& other) const override;
+    const std::vector<uint32_t>& get_categories() const { return categories_; }
 
-    virtual std::size_t hash() const override;
+    // in the order of the nominal attributes in the Schema
+    const std::vector<NominalTerm>& get_nominal_terms() const { return nominal_terms_; }
 
-    virtual std::string to_str() const override;
+    bool covers(const Instance& instance) const;
 
-  private:
+    double distance(const Instance& instance) const;
 
-    std::string category_;
+    /*
+     * Same as distance(instance), but gives up as soon as the distance is
+     * known to be greater than upper_bound, returning infinity in that case.
+     */
+    double distance(const Instance& instance, double upper_bound) const;
 
-};
+    Rule::Ptr adapt(const Instance& instance) const;
 
-class Rule : public Stringifiable
-{
-  public:
+    /*
+     * Same as adapt(instance), but the generalized rule is written into rule,
+     * reusing its storage (e.g. the one of a rejected candidate). Like the
+     * rules returned by adapt(instance), it has to be evaluated again.
+     */
+    void adapt(const Instance& instance, Rule& rule) const;
 
-    typedef std::shared_ptr<Rule> Ptr;
+    /*
+     * Canonical binary form of a rule: its bounds rounded to multiples of
+     * EPSILON (dropped conditions having the same bit pattern), its category
+     * codes (two per word) and its consequent. Two rules are equal if and only
+     * if their keys are equal.
+     */
+    typedef std::vector<uint64_t> Key;
 
-    Rule(const Instance& instance, const std::vector<AttributeMeta::Ptr>& meta);
+    const Key& get_key() const { return key_; }
 
-    const std::string& get_consequent() const;
+    bool operator==(const Rule& other) const { return key_ == other.key_; }
 
-    bool covers(const Instance& instance) const;
+    void evaluate_rule(const Dataframe& df);
 
-    double distance(const Instance& instance) const;
+    // one bit per row of the dataframe on which the rule has been evaluated
+    const Bitset& get_covered() const { return covered_; }
 
-    Rule::Ptr adapt(const Instance& instance) const;
-
-    bool operator==(const Rule& other) const;
+    int get_n_instances_covered() const { return n_instances_covered_; }
 
-    void evaluate_rule(const Dataframe& df);
+    int get_n_correctly_classified() const { return n_correctly_classified_; }
 
-    int get_n_instances_covered() const { return n_instances_covered_; }
+    int get_n_instances_same_class() const { return n_instances_same_class_; }
 
     double get_coverage() const { return coverage_; }
 
     double get_precision() const { return precision_; }
 
     double get_f1_score() const { return 2.0/(1/coverage_ + 1/precision_); }
-    
+
     //double get_f1_score() const { return precision_; }
 
-    std::size_t hash() const;
+    // of the key (computed once)
+    std::size_t hash() const { return hash_; }
 
     virtual std::string to_str() const override;
 
   private:
 
-    std::vector<Condition::Ptr> antecedent_;
-    Attribute::Ptr consequent_;
-    int n_instances_covered_;
+    static double EPSILON;
+
+    Schema::Ptr schema_;
+    std::vector<double> bounds_;
+    std::vector<uint32_t> categories_;
+    std::vector<NominalTerm> nominal_terms_; // derived from categories_
+    uint32_t consequent_;
+    Key key_;                                // derived from the above
+    std::size_t hash_;
+    Bitset covered_;
+    int n_instances_covered_, n_correctly_classified_, n_instances_same_class_;
     double coverage_, precision_;
+
+    void update_scores();
+
+    void update_nominal_terms();
+
+    void update_key();
 };
 
 struct rule_hash
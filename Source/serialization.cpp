@@ -0,0 +1,150 @@
+#include "serialization.h"
+
+namespace rise
+{
+
+namespace /* utils for internal usage */
+{
+
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+const uint32_t REAL_ATTRIBUTE = 0;
+const uint32_t NOMINAL_ATTRIBUTE = 1;
+
+} /* end anonymous namespace */
+
+// BinaryWriter's methods
+
+BinaryWriter::BinaryWriter(const std::string& filename, const char* magic, uint32_t version)
+  : filename_(filename), out_(filename, std::ios::binary), offset_(0)
+{
+  if (not out_) throw RiseException(std::string("Cannot write file: ") + filename);
+  write_bytes(magic, 8);
+  write(version);
+  write(BYTE_ORDER_MARK);
+}
+
+void BinaryWriter::write_bytes(const void* data, std::size_t size)
+{
+  out_.write(static_cast<const char*>(data), size);
+  offset_ += size;
+}
+
+void BinaryWriter::write_string(const std::string& str)
+{
+  write<uint32_t>(str.size());
+  write_bytes(str.data(), str.size());
+}
+
+void BinaryWriter::close()
+{
+  out_.close();
+  if (not out_) throw RiseException(std::string("Error writing file: ") + filename_);
+}
+
+// BinaryReader's methods
+
+BinaryReader::BinaryReader(const std::string& filename, const char* magic, uint32_t version)
+  : filename_(filename), file_(filename), pos_(file_.begin())
+{
+  if (file_.size() < 8 or std::memcmp(read_bytes(8), magic, 8) != 0)
+  {
+    fail("Unexpected type of file");
+  }
+  uint32_t file_version = read<uint32_t>();
+  if (file_version != version) fail("Unsupported version " + std::to_string(file_version));
+  if (read<uint32_t>() != BYTE_ORDER_MARK) fail("Written with a different byte order");
+}
+
+const char* BinaryReader::read_bytes(std::size_t size)
+{
+  if (size > file_.end() - pos_) fail("Truncated file");
+  const char* data = pos_;
+  pos_ += size;
+  return data;
+}
+
+std::string BinaryReader::read_string()
+{
+  uint32_t size = read<uint32_t>();
+  return std::string(read_bytes(size), size);
+}
+
+void BinaryReader::fail(const std::string& msg) const
+{
+  throw RiseException(msg + ": " + filename_);
+}
+
+// Free methods' implementation
+
+void write_attributes(BinaryWriter& writer, const std::vector<AttributeMeta::Ptr>& xmeta,
+    const AttributeMeta::Ptr& ymeta)
+{
+  writer.write<uint32_t>(xmeta.size());
+  for (int column = 0; column <= xmeta.size(); ++column)
+  {
+    const AttributeMeta::Ptr& meta = column < xmeta.size()? xmeta[column] : ymeta;
+    if (auto rmeta = std::dynamic_pointer_cast<RealAttributeMeta>(meta))
+    {
+      writer.write(REAL_ATTRIBUTE);
+      writer.write_string(rmeta->get_name());
+      writer.write(rmeta->get_lower_bound());
+      writer.write(rmeta->get_upper_bound());
+    }
+    else
+    {
+      auto nmeta = std::static_pointer_cast<NominalAttributeMeta>(meta);
+      writer.write(NOMINAL_ATTRIBUTE);
+      writer.write_string(nmeta->get_name());
+      writer.write(nmeta->get_domain_size());
+      for (const std::string& category : nmeta->get_domain()) writer.write_string(category);
+      writer.write_array(nmeta->get_lookup());
+    }
+  }
+}
+
+void read_attributes(BinaryReader& reader, std::vector<AttributeMeta::Ptr>& xmeta,
+    AttributeMeta::Ptr& ymeta)
+{
+  uint32_t n_attributes = reader.read<uint32_t>();
+  std::vector<AttributeMeta::Ptr> all_meta(n_attributes + 1);
+  for (AttributeMeta::Ptr& meta : all_meta)
+  {
+    uint32_t type = reader.read<uint32_t>();
+    std::string name = reader.read_string();
+    if (type == REAL_ATTRIBUTE)
+    {
+      auto rmeta = std::make_shared<RealAttributeMeta>(name);
+      rmeta->set_lower_bound(reader.read<double>());
+      rmeta->set_upper_bound(reader.read<double>());
+      meta = rmeta;
+    }
+    else if (type == NOMINAL_ATTRIBUTE)
+    {
+      auto nmeta = std::make_shared<NominalAttributeMeta>(name);
+      uint32_t domain_size = reader.read<uint32_t>();
+      std::set<std::string> domain;
+      for (uint32_t code = 0; code < domain_size; ++code) domain.insert(reader.read_string());
+      if (domain.size() != domain_size) reader.fail("Repeated categories in " + name);
+      nmeta->set_domain(domain);
+      std::vector<double> lu;
+      reader.read_array(lu);
+      if (not lu.empty() and lu.size() != uint64_t(domain_size)*domain_size)
+      {
+        reader.fail("Wrong size of the lookup table of " + name);
+      }
+      if (not lu.empty()) nmeta->set_lookup(lu);
+      meta = nmeta;
+    }
+    else reader.fail("Unknown attribute type");
+  }
+  if (not std::dynamic_pointer_cast<NominalAttributeMeta>(all_meta.back()))
+  {
+    reader.fail("The target attribute is not nominal");
+  }
+  ymeta = all_meta.back();
+  all_meta.pop_back();
+  xmeta = all_meta;
+}
+
+} /* end namespace rise */
+
@@ -0,0 +1,114 @@
+#ifndef SERIALIZATION_H
+#define SERIALIZATION_H
+
+#include "common.h"
+#include "csv_reader.h"
+
+#include <cstring>
+#include <fstream>
+
+namespace rise
+{
+
+class BinaryWriter;
+class BinaryReader;
+
+/*
+ * Binary files (in the native byte order) made of a header and a sequence of
+ * values, strings and arrays. Arrays are prefixed by their number of elements
+ * (uint64_t) and start at offsets multiple of 8, so the file can be mapped and
+ * used in place. Strings are stored as their length (uint32_t) followed by
+ * their characters.
+ *
+ *   header: magic (8 chars), version (uint32_t), byte order mark (uint32_t)
+ */
+class BinaryWriter
+{
+  public:
+
+    BinaryWriter(const std::string& filename, const char* magic, uint32_t version);
+
+    void write_bytes(const void* data, std::size_t size);
+
+    template <class T>
+    void write(const T& value) { write_bytes(&value, sizeof(T)); }
+
+    void write_string(const std::string& str);
+
+    template <class T>
+    void write_array(const std::vector<T>& values)
+    {
+      write<uint64_t>(values.size());
+      while (offset_%8) write<char>(0);
+      write_bytes(values.data(), values.size()*sizeof(T));
+    }
+
+    // must be called to detect errors while writing
+    void close();
+
+  private:
+
+    std::string filename_;
+    std::ofstream out_;
+    std::size_t offset_;
+};
+
+/*
+ * Reads a file written by BinaryWriter, checking the header and the bounds of
+ * every read (a truncated or corrupt file raises a RiseException).
+ */
+class BinaryReader
+{
+  public:
+
+    BinaryReader(const std::string& filename, const char* magic, uint32_t version);
+
+    const char* read_bytes(std::size_t size);
+
+    template <class T>
+    T read()
+    {
+      T value;
+      std::memcpy(&value, read_bytes(sizeof(T)), sizeof(T));
+      return value;
+    }
+
+    std::string read_string();
+
+    template <class T>
+    void read_array(std::vector<T>& values)
+    {
+      uint64_t size = read<uint64_t>();
+      while ((pos_ - file_.begin())%8) read_bytes(1);
+      if (size > (file_.end() - pos_)/sizeof(T)) fail("Truncated file");
+      values.resize(size);
+      std::memcpy(values.data(), read_bytes(size*sizeof(T)), size*sizeof(T));
+    }
+
+    bool at_end() const { return pos_ == file_.end(); }
+
+    // throws a RiseException mentioning the file
+    [[noreturn]] void fail(const std::string& msg) const;
+
+  private:
+
+    std::string filename_;
+    MappedFile file_;
+    const char* pos_;
+};
+
+/*
+ * Metadata of the attributes (the target last): type, name and either the
+ * bounds of a real attribute or the domain and the lookup table (maybe empty)
+ * of a nominal attribute.
+ */
+void write_attributes(BinaryWriter& writer, const std::vector<AttributeMeta::Ptr>& xmeta,
+    const AttributeMeta::Ptr& ymeta);
+
+void read_attributes(BinaryReader& reader, std::vector<AttributeMeta::Ptr>& xmeta,
+    AttributeMeta::Ptr& ymeta);
+
+} /* end namespace rise */
+
+#endif
+